@@ -0,0 +1,159 @@
+#include <hayai.hpp>
+
+#include <malloc.h>
+#include <filesystem>
+#include <iostream>
+
+#include "editor/forest.h"
+
+// Heap bytes currently in use
+inline
+std::size_t heap_usage(){
+    return mallinfo2().uordblks;
+}
+
+// Build `lines` production lines of miner -> smelter -> constructor
+inline
+void generate_lines(Forest& forest, int lines){
+    auto& rsc = Resources::instance();
+
+    int miner       = rsc.find_building("Miner");
+    int smelter     = rsc.find_building("Smelter");
+    int constructor = rsc.find_building("Constructor");
+
+    int iron_ore    = rsc.find_recipe(miner, "Iron Ore");
+    int iron_ingot  = rsc.find_recipe(smelter, "Iron Ingot");
+    int iron_plate  = rsc.find_recipe(constructor, "Iron Plate");
+
+    forest.begin_batch();
+
+    for(int i = 0; i < lines; ++i){
+        float y = float(i) * 100.f;
+
+        Node* n0 = forest.new_node(ImVec2(  0, y), miner, iron_ore);
+        Node* n1 = forest.new_node(ImVec2(200, y), smelter, iron_ingot);
+        Node* n2 = forest.new_node(ImVec2(400, y), constructor, iron_plate);
+
+        forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+        forest.new_link(&n1->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+    }
+
+    forest.commit();
+}
+
+
+class ForestBench: public ::hayai::Fixture
+{
+public:
+    static constexpr int lines = 100000;
+
+    virtual void SetUp() {
+        if (Resources::instance().buildings.size() == 0){
+            Resources::instance().load_configs();
+        }
+
+        auto before = heap_usage();
+        generate_lines(forest, lines);
+        auto after = heap_usage();
+
+        bytes_per_node = double(after - before) / double(forest.node_count());
+    }
+
+    virtual void TearDown(){
+        static bool reported = false;
+
+        if (!reported){
+            reported = true;
+            std::cout << "\n"
+                      << "    sizeof(Node)     : " << sizeof(Node) << "\n"
+                      << "    sizeof(Pin)      : " << sizeof(Pin) << "\n"
+                      << "    sizeof(NodeLink) : " << sizeof(NodeLink) << "\n"
+                      << "    bytes per node   : " << bytes_per_node
+                      << " (" << forest.node_count() << " nodes, "
+                      << forest.link_count() << " links, logic and links included)\n";
+        }
+        forest.clear();
+    }
+
+    Forest forest;
+    double bytes_per_node = 0;
+};
+
+BENCHMARK_F(ForestBench, Traverse, 10, 10)
+{
+    std::size_t count = 0;
+    forest.traverse([&count](Node*){ count += 1; });
+}
+
+BENCHMARK_F(ForestBench, Topological, 10, 10)
+{
+    std::size_t count = 0;
+    forest.topological([&count](Node*){ count += 1; });
+}
+
+// The save is written before the timed runs, only loading it is measured
+class SaveBench: public ForestBench
+{
+public:
+    virtual void SetUp() {
+        ForestBench::SetUp();
+        forest.save_binary(path);
+    }
+
+    virtual void TearDown(){
+        std::filesystem::remove(path);
+        ForestBench::TearDown();
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "puzzle_forest_bench.bin").string();
+};
+
+BENCHMARK_F(SaveBench, LoadBinary, 1, 5)
+{
+    Forest loaded;
+    loaded.load_binary(path);
+}
+
+BENCHMARK_F(SaveBench, LoadBinaryOneThread, 1, 5)
+{
+    Forest loaded;
+    loaded.load_binary(path, nullptr, 1);
+}
+
+class CompressedSaveBench: public SaveBench
+{
+public:
+    virtual void SetUp() {
+        ForestBench::SetUp();
+        forest.save_binary(path, true);
+    }
+};
+
+BENCHMARK_F(CompressedSaveBench, LoadCompressed, 1, 5)
+{
+    Forest loaded;
+    loaded.load_binary(path);
+}
+
+// saves/<name>.json, the format of the saves before the binary one
+class JsonSaveBench: public ForestBench
+{
+public:
+    virtual void SetUp() {
+        ForestBench::SetUp();
+        forest.export_json(name, true);
+    }
+
+    virtual void TearDown(){
+        std::filesystem::remove(puzzle::binary_path() + "/saves/" + name + ".json");
+        ForestBench::TearDown();
+    }
+
+    std::string name = "puzzle_forest_bench";
+};
+
+BENCHMARK_F(JsonSaveBench, LoadJson, 1, 5)
+{
+    Forest loaded;
+    loaded.import_json(name);
+}
@@ -0,0 +1,149 @@
+#include <hayai.hpp>
+
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "editor/forest.h"
+
+// Hardware cache misses of the calling thread, -1 if perf is not available
+struct CacheMisses {
+    int fd = -1;
+
+    CacheMisses(){
+        perf_event_attr attr = {};
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.size           = sizeof(attr);
+        attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~CacheMisses(){
+        if (fd >= 0){
+            close(fd);
+        }
+    }
+
+    template<typename Fun>
+    long long count(Fun&& fun){
+        if (fd < 0){
+            fun();
+            return -1;
+        }
+
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        fun();
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        long long misses = 0;
+        if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+            return -1;
+        return misses;
+    }
+};
+
+// Build `lines` production lines of miner -> smelter -> constructor
+// one stage at a time, like a save listing its buildings by type,
+// so the nodes of a line are far apart in memory
+inline
+void generate_stages(Forest& forest, int lines){
+    auto& rsc = Resources::instance();
+
+    int miner       = rsc.find_building("Miner");
+    int smelter     = rsc.find_building("Smelter");
+    int constructor = rsc.find_building("Constructor");
+
+    int recipes[] = {
+        rsc.find_recipe(miner, "Iron Ore"),
+        rsc.find_recipe(smelter, "Iron Ingot"),
+        rsc.find_recipe(constructor, "Iron Plate"),
+    };
+    int buildings[] = {miner, smelter, constructor};
+
+    std::vector<Node*> stages[3];
+    forest.begin_batch();
+
+    for(int s = 0; s < 3; ++s){
+        for(int i = 0; i < lines; ++i){
+            auto pos = ImVec2(float(s) * 200.f, float(i) * 100.f);
+            stages[s].push_back(forest.new_node(pos, buildings[s], recipes[s]));
+        }
+    }
+
+    for(std::size_t i = 0; i < std::size_t(lines); ++i){
+        forest.new_link(&stages[0][i]->pins[RightToLeft][0], &stages[1][i]->pins[LeftToRight][0]);
+        forest.new_link(&stages[1][i]->pins[RightToLeft][0], &stages[2][i]->pins[LeftToRight][0]);
+    }
+
+    forest.commit();
+}
+
+
+class SimulationBench: public ::hayai::Fixture
+{
+public:
+    static constexpr int lines = 100000;
+
+    virtual void SetUp() {
+        if (Resources::instance().buildings.size() == 0){
+            Resources::instance().load_configs();
+        }
+
+        generate_stages(forest, lines);
+
+        static bool reported = false;
+        if (!reported){
+            reported = true;
+            report();
+        }
+    }
+
+    virtual void TearDown(){
+        forest.clear();
+    }
+
+    // Cache misses of a tick in creation order and in compiled order
+    void report(){
+        CacheMisses counter;
+
+        // warm up
+        forest.traverse([](Node* n){ n->logic->tick(); });
+
+        auto before = counter.count([this](){
+            forest.traverse([](Node* n){ n->logic->tick(); });
+        });
+
+        sim.compile();
+        sim.compute_production();
+
+        auto after = counter.count([this](){
+            sim.compute_production();
+        });
+
+        std::cout << "\n"
+                  << "    cache misses per tick (" << forest.node_count() << " nodes)\n"
+                  << "    creation order   : " << before << "\n"
+                  << "    compiled order   : " << after << "\n";
+    }
+
+    Forest     forest;
+    Simulation sim{&forest};
+};
+
+BENCHMARK_F(SimulationBench, Traverse, 10, 10)
+{
+    forest.traverse([](Node* n){ n->logic->tick(); });
+}
+
+BENCHMARK_F(SimulationBench, Compiled, 10, 10)
+{
+    sim.compute_production();
+}
@@ -0,0 +1,298 @@
+#include "config.h"
+#include "mapped_file.h"
+
+#include <cstring>
+#include <filesystem>
+
+// Compiled catalog, native endianness
+//
+//  CatalogHeader
+//  string      items [item_count]          (in ID order)
+//  building    buildings [building_count]
+//
+//  building:   string name, float energy, w, l, h,
+//              uint32 side count, {string side, uint32 pin count, string pins [...]} [...]
+//              uint32 recipe count, recipe [...]
+//  recipe:     string name, float crafting_time, string texture,
+//              uint32 input count, item [...], uint32 output count, item [...]
+//  item:       string name, float qty, float speed, char type
+//  string:     uint32 size, char [size]
+//
+// The file is read sequentially from the mapping, there is nothing to parse
+namespace {
+
+constexpr char          catalog_magic[4] = {'P', 'Z', 'L', 'C'};
+constexpr std::uint32_t catalog_version  = 1;
+
+struct CatalogHeader {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint64_t checksum;     // of the JSON files it was compiled from
+    std::uint32_t item_count;
+    std::uint32_t building_count;
+};
+
+// FNV-1a
+std::uint64_t hash(std::uint64_t h, char const* data, std::size_t size){
+    for(std::size_t i = 0; i < size; ++i){
+        h = (h ^ std::uint8_t(data[i])) * 1099511628211ull;
+    }
+    return h;
+}
+
+struct CatalogWriter {
+    std::vector<char> data;
+
+    template<typename T>
+    void write(T const& v){
+        auto* bytes = reinterpret_cast<char const*>(&v);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void write(std::string const& str){
+        write(std::uint32_t(str.size()));
+        data.insert(data.end(), str.begin(), str.end());
+    }
+
+    void write(std::vector<Item> const& items){
+        write(std::uint32_t(items.size()));
+
+        for(auto& item: items){
+            write(item.name);
+            write(item.qty);
+            write(item.speed);
+            write(item.type);
+        }
+    }
+};
+
+// Reads fail once the end of the file is reached
+struct CatalogReader {
+    char const* data;
+    std::size_t size;
+    std::size_t pos = 0;
+    bool        ok  = true;
+
+    template<typename T>
+    T read(){
+        T v = T();
+
+        if (pos + sizeof(T) > size){
+            ok = false;
+            return v;
+        }
+
+        std::memcpy(&v, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    // Element count, a count larger than the rest of the file is corrupted
+    std::uint32_t read_count(){
+        auto n = read<std::uint32_t>();
+
+        if (n > size - pos){
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+
+    std::string read_string(){
+        auto n = read<std::uint32_t>();
+
+        if (!ok || pos + n > size){
+            ok = false;
+            return std::string();
+        }
+
+        pos += n;
+        return std::string(data + pos - n, n);
+    }
+
+    void read_items(std::vector<Item>& items){
+        items.resize(read_count());
+
+        for(auto& item: items){
+            item.name  = read_string();
+            item.qty   = read<float>();
+            item.speed = read<float>();
+            item.type  = read<char>();
+
+            if (!ok){
+                items.clear();
+                return;
+            }
+        }
+    }
+};
+
+}
+
+std::uint64_t Resources::catalog_checksum(std::string const& dir){
+    std::vector<std::filesystem::path> sources;
+    std::error_code err;
+
+    for(auto& entry: std::filesystem::directory_iterator(dir, err)){
+        if (entry.path().extension() == ".json"){
+            sources.push_back(entry.path());
+        }
+    }
+
+    // directory order is not specified
+    std::sort(sources.begin(), sources.end());
+
+    std::uint64_t h = 14695981039346656037ull;
+
+    for(auto& source: sources){
+        auto name = source.filename().string();
+        h = hash(h, name.data(), name.size());
+
+        MappedFile file(source.string());
+        h = hash(h, file.data, file.size);
+    }
+    return h;
+}
+
+bool Resources::save_catalog(std::string const& path, std::uint64_t checksum) const {
+    CatalogWriter out;
+
+    CatalogHeader header = {};
+    std::memcpy(header.magic, catalog_magic, sizeof(catalog_magic));
+    header.version        = catalog_version;
+    header.checksum       = checksum;
+    header.item_count     = std::uint32_t(items.size());
+    header.building_count = std::uint32_t(buildings.size());
+    out.write(header);
+
+    for(auto& item: items){
+        out.write(item);
+    }
+
+    for(auto& building: buildings){
+        out.write(building.name);
+        out.write(building.energy);
+        out.write(building.w);
+        out.write(building.l);
+        out.write(building.h);
+
+        out.write(std::uint32_t(building.layout.size()));
+        for(auto& side: building.layout){
+            out.write(side.first);
+            out.write(std::uint32_t(side.second.size()));
+
+            for(auto& pin: side.second){
+                out.write(pin);
+            }
+        }
+
+        out.write(std::uint32_t(building.recipes.size()));
+        for(auto& recipe: building.recipes){
+            out.write(recipe.recipe_name);
+            out.write(recipe.crafting_time);
+            out.write(recipe.texture);
+            out.write(recipe.inputs);
+            out.write(recipe.outputs);
+        }
+    }
+
+    // written aside then renamed, a reader never sees half of it
+    auto tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!file || !file.write(out.data.data(), std::streamsize(out.data.size()))){
+            warn("Could not write {}", tmp);
+            return false;
+        }
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmp, path, err);
+
+    if (err){
+        warn("Could not write {}: {}", path, err.message());
+        std::filesystem::remove(tmp, err);
+        return false;
+    }
+    return true;
+}
+
+bool Resources::load_catalog(std::string const& path, std::uint64_t checksum){
+    MappedFile file(path);
+
+    if (file.data == nullptr || file.size < sizeof(CatalogHeader))
+        return false;
+
+    CatalogReader in{file.data, file.size};
+    auto header = in.read<CatalogHeader>();
+
+    if (std::memcmp(header.magic, catalog_magic, sizeof(catalog_magic)) != 0
+            || header.version != catalog_version
+            || header.checksum != checksum
+            || header.item_count > file.size
+            || header.building_count > file.size){
+        return false;
+    }
+
+    std::vector<std::string> names(header.item_count);
+    for(auto& name: names){
+        name = in.read_string();
+    }
+
+    // read aside, the catalog is replaced only if the file is complete
+    std::vector<Building> loaded(header.building_count);
+
+    for(auto& building: loaded){
+        building.name   = in.read_string();
+        building.energy = in.read<float>();
+        building.w      = in.read<float>();
+        building.l      = in.read<float>();
+        building.h      = in.read<float>();
+
+        // the layout orders the sides itself (pin_sides)
+        auto sides = in.read_count();
+        for(std::uint32_t i = 0; i < sides && in.ok; ++i){
+            auto side = in.read_string();
+            std::vector<std::string> pins(in.read_count());
+
+            for(auto& pin: pins){
+                pin = in.read_string();
+            }
+
+            if (in.ok && !building.layout.emplace(side, std::move(pins)).second){
+                warn("{} has the side {} of {} twice", path, side, building.name);
+                return false;
+            }
+        }
+
+        building.recipes.resize(in.read_count());
+        for(auto& recipe: building.recipes){
+            recipe.recipe_name   = in.read_string();
+            recipe.crafting_time = in.read<float>();
+            recipe.texture       = in.read_string();
+            in.read_items(recipe.inputs);
+            in.read_items(recipe.outputs);
+
+            if (!in.ok)
+                break;
+        }
+
+        if (!in.ok)
+            break;
+    }
+
+    if (!in.ok){
+        warn("{} is truncated", path);
+        return false;
+    }
+
+    buildings = std::move(loaded);
+    for(auto& name: names){
+        add_item(name);
+    }
+    index();
+
+    debug("Found {} buildings in {}", buildings.size(), path);
+    return true;
+}
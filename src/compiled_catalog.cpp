@@ -0,0 +1,82 @@
+#include "config.h"
+
+// catalog_data.h is generated in the build directory by catalog_gen
+// from resources/*.json, see src/CMakeLists.txt
+#ifdef PUZZLE_COMPILED_CATALOG
+#include "catalog_data.h"
+
+namespace {
+
+std::vector<Item> compiled_items(std::uint32_t first, std::uint32_t count){
+    std::vector<Item> items;
+    items.reserve(count);
+
+    for(auto i = first; i < first + count; ++i){
+        auto& item = catalog_data::recipe_items[i];
+        items.push_back({std::string(item.name), item.qty, item.speed, item.type});
+    }
+    return items;
+}
+
+}
+
+bool Resources::load_compiled(){
+    // the catalog cannot change while the binary runs,
+    // the nodes keep pointing to the same buildings
+    if (checksum == catalog_data::checksum && buildings.size() == catalog_data::buildings.size()){
+        return true;
+    }
+
+    std::vector<Building> loaded(catalog_data::buildings.size());
+
+    for(std::size_t b = 0; b < loaded.size(); ++b){
+        auto& data = catalog_data::buildings[b];
+        auto& building = loaded[b];
+
+        building.name   = std::string(data.name);
+        building.energy = data.energy;
+        building.w      = data.w;
+        building.l      = data.l;
+        building.h      = data.h;
+        building.kind   = data.kind;
+
+        for(auto s = data.first_side; s < data.first_side + data.side_count; ++s){
+            auto& side = catalog_data::sides[s];
+            auto& pins = building.layout[std::string(side.name)];
+
+            for(auto p = side.first_pin; p < side.first_pin + side.pin_count; ++p){
+                pins.emplace_back(catalog_data::pins[p]);
+            }
+        }
+
+        building.recipes.reserve(data.recipe_count);
+        for(auto r = data.first_recipe; r < data.first_recipe + data.recipe_count; ++r){
+            auto& recipe = catalog_data::recipes[r];
+            building.recipes.push_back({
+                std::string(recipe.name),
+                recipe.crafting_time,
+                compiled_items(recipe.first_input, recipe.input_count),
+                compiled_items(recipe.first_output, recipe.output_count),
+                std::string(recipe.texture)
+            });
+        }
+    }
+
+    buildings = std::move(loaded);
+    for(auto& name: catalog_data::items){
+        add_item(std::string(name));
+    }
+    index();
+
+    checksum = catalog_data::checksum;
+    debug("Found {} compiled buildings", buildings.size());
+    return true;
+}
+
+#else
+
+bool Resources::load_compiled(){
+    return false;
+}
+
+#endif
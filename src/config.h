@@ -7,6 +7,8 @@
 
 #include <fstream>
 #include <algorithm>
+#include <map>
+#include <string_view>
 
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
@@ -26,8 +28,101 @@ struct Recipe {
     std::string       texture;
 };
 
+// Buildings the simulation handles specially,
+// the others produce from their recipe
+enum class BuildingKind: std::uint8_t {
+    Producer,
+    Relay,              // splitters and mergers
+    PipelineCross,      // relay whose pins are both inputs and outputs
+    Storage
+};
+
+// Resolved when the catalog is compiled (catalog_gen), the simulation
+// only compares the kind on every tick
+constexpr std::pair<std::string_view, BuildingKind> building_kinds[] = {
+    {"Conveyor Splitter",           BuildingKind::Relay},
+    {"Conveyor Merger",             BuildingKind::Relay},
+    {"Pipeline Junction Cross (S)", BuildingKind::PipelineCross},
+    {"Pipeline Junction Cross (M)", BuildingKind::PipelineCross},
+    {"Storage Container",           BuildingKind::Storage},
+};
+
+constexpr BuildingKind building_kind(std::string_view name){
+    for(auto& kind: building_kinds){
+        if (kind.first == name)
+            return kind.second;
+    }
+    return BuildingKind::Producer;
+}
+
+static_assert(building_kind("Conveyor Merger") == BuildingKind::Relay);
+static_assert(building_kind("Smelter") == BuildingKind::Producer);
+
+// Catalog compiled into the binary by catalog_gen (catalog_data.h),
+// ranges are indices into the flat tables of the generated header
+struct CompiledItem {
+    std::string_view name;
+    float            qty;
+    float            speed;
+    char             type;
+};
+
+struct CompiledRecipe {
+    std::string_view name;
+    float            crafting_time;
+    std::string_view texture;
+    std::uint32_t    first_input;
+    std::uint32_t    input_count;
+    std::uint32_t    first_output;
+    std::uint32_t    output_count;
+};
+
+struct CompiledSide {
+    std::string_view name;
+    std::uint32_t    first_pin;
+    std::uint32_t    pin_count;
+};
+
+struct CompiledBuilding {
+    std::string_view name;
+    float            energy;
+    float            w;
+    float            l;
+    float            h;
+    BuildingKind     kind;
+    std::uint32_t    first_side;
+    std::uint32_t    side_count;
+    std::uint32_t    first_recipe;
+    std::uint32_t    recipe_count;
+};
+
+// Sides of a building in the order their pins are numbered.
+// Pin IDs and slots (saves, journal, clipboard, world files) follow it,
+// it is the order the existing saves were made with
+constexpr std::string_view pin_sides[] = {"right", "top", "left", "bottom"};
+
+constexpr std::size_t side_rank(std::string_view side){
+    for(std::size_t i = 0; i < std::size(pin_sides); ++i){
+        if (pin_sides[i] == side)
+            return i;
+    }
+    return std::size(pin_sides);
+}
+
+// Unknown sides go last, by name
+struct SideOrder {
+    bool operator()(std::string const& a, std::string const& b) const {
+        auto ra = side_rank(a);
+        auto rb = side_rank(b);
+
+        if (ra != rb)
+            return ra < rb;
+        return a < b;
+    }
+};
+
 struct Building {
-    using Layout = std::unordered_map<std::string, std::vector<std::string>>;
+    using Layout = std::map<std::string, std::vector<std::string>, SideOrder>;
 
     std::string name;
     float       energy;
@@ -39,6 +134,16 @@ struct Building {
     std::vector<Recipe>      recipes;
     Layout                   layout;
     std::vector<const char*> _cached_names;
+    BuildingKind             kind = BuildingKind::Producer;   // set by Resources::index
+
+    // Number of pins of the building
+    std::size_t pin_count() const {
+        std::size_t count = 0;
+        for(auto& side: layout){
+            count += side.second.size();
+        }
+        return count;
+    }
 
     std::vector<const char*> const& recipe_names(){
         if (_cached_names.size() == 0){
@@ -59,6 +164,12 @@ void from_json(const json& j, Recipe& p);
 
 void from_json(const json& j, Building& p);
 
+// Recipe of a building, by index
+struct RecipeRef {
+    int building;
+    int recipe;
+};
+
 struct Resources {
     static Resources& instance(){
         static Resources rsc;
@@ -69,8 +180,39 @@ struct Resources {
 
     Resources(Resources const&) = delete;
 
+    // The catalog compiled into the binary is used by default, nothing is read.
+    // Without it (COMPILED_CATALOG=OFF, modding and development) the catalog is parsed
+    // from the JSON files once and compiled to catalog.bin next to the binary,
+    // it is loaded from there until one of the JSON files changes
     void load_configs(){
-        auto path = puzzle::binary_path() + "/resources/buildings.json";
+        if (load_compiled()){
+            return;
+        }
+
+        checksum = catalog_checksum(puzzle::binary_path() + "/resources");
+        auto catalog = puzzle::binary_path() + "/catalog.bin";
+
+        if (load_catalog(catalog, checksum)){
+            return;
+        }
+
+        load_json();
+        save_catalog(catalog, checksum);
+    }
+
+    // Compiled catalog, see catalog.cpp
+    // the checksum covers the name and content of every JSON file of the directory
+    static std::uint64_t catalog_checksum(std::string const& dir);
+    bool save_catalog(std::string const& path, std::uint64_t checksum) const;
+
+    // Returns false if the file is missing, outdated (checksum) or corrupted
+    bool load_catalog(std::string const& path, std::uint64_t checksum);
+
+    // Returns false if the binary was built without the catalog, see compiled_catalog.cpp
+    bool load_compiled();
+
+    void load_json(std::string const& dir = puzzle::binary_path() + "/resources"){
+        auto path = dir + "/buildings.json";
         std::ifstream buildings_file(path, std::ios::in | std::ios::binary);
 
         if (!buildings_file){
@@ -84,8 +226,9 @@ struct Resources {
 
         // load the recipes of each buildings
         for(auto& building: buildings){
-            load_recipes(building);
+            load_recipes(building, dir);
         }
+        index();
     }
 
     std::vector<const char*> building_names(){
@@ -101,7 +244,7 @@ struct Resources {
         return names;
     }
 
-    void load_recipes(Building& building){
+    void load_recipes(Building& building, std::string const& dir){
         std::string name(building.name.size(), ' ');
         std::transform(std::begin(building.name), std::end(building.name), name.begin(), [] (char c) -> char {
             if (c == ' ')
@@ -110,7 +253,7 @@ struct Resources {
             return std::tolower(c);
         });
 
-        auto path = puzzle::binary_path() + "/resources/" + name + ".json";
+        auto path = dir + "/" + name + ".json";
         std::ifstream recipes_file(path, std::ios::in | std::ios::binary);
 
         if (!recipes_file){
@@ -122,9 +265,33 @@ struct Resources {
         recipes_file >> recipes;
         recipes.get_to(building.recipes);
 
+        for(auto& recipe: building.recipes){
+            for(auto* items: {&recipe.inputs, &recipe.outputs}){
+                for(auto& item: *items){
+                    add_item(item.name);
+                }
+            }
+        }
+
         debug("Found {} recipes for {}", building.recipes.size(), building.name);
     }
 
+    // Items are given dense IDs when the recipes are loaded
+    int add_item(std::string const& name){
+        auto result = item_ids.emplace(name, int(items.size()));
+        if (result.second){
+            items.push_back(name);
+        }
+        return result.first->second;
+    }
+
+    int find_item(std::string const& name) const {
+        auto item = item_ids.find(name);
+        if (item == item_ids.end())
+            return -1;
+        return item->second;
+    }
+
     Image* load_texture(std::string path){
         if (path.size() == 0) {
             return nullptr;
@@ -143,30 +310,88 @@ struct Resources {
         return p.get();
     }
 
-    int find_building(std::string const& name){
-        for(auto i = 0u; i < buildings.size(); ++i){
-            if (buildings[i].name == name)
-                return int(i);
-        }
-        return -1;
+    int find_building(std::string const& name) const {
+        auto building = building_ids.find(name);
+        if (building == building_ids.end())
+            return -1;
+        return building->second;
     }
 
-    int find_recipe(int building, std::string const& name){
-        if (building < 0){
+    int find_recipe(int building, std::string const& name) const {
+        if (building < 0 || std::size_t(building) >= recipe_ids.size()){
             return -1;
         }
 
-        auto recipes = buildings[std::size_t(building)].recipes;
+        auto& ids = recipe_ids[std::size_t(building)];
+        auto recipe = ids.find(name);
+        if (recipe == ids.end())
+            return -1;
+        return recipe->second;
+    }
+
+    // Recipes with the item among their outputs (producers) or inputs (consumers)
+    std::vector<RecipeRef> const& producers(int item) const {
+        return recipes_of(producer_index, item);
+    }
+
+    std::vector<RecipeRef> const& consumers(int item) const {
+        return recipes_of(consumer_index, item);
+    }
 
-        for(auto i = 0u; i < recipes.size(); ++i){
-            if (recipes[i].recipe_name == name)
-                return int(i);
+    // Rebuild the lookup tables once the buildings are loaded
+    void index(){
+        building_ids.clear();
+        recipe_ids.assign(buildings.size(), {});
+        producer_index.assign(items.size(), {});
+        consumer_index.assign(items.size(), {});
+
+        for(auto b = 0u; b < buildings.size(); ++b){
+            auto& building = buildings[b];
+            building_ids.emplace(building.name, int(b));
+            building.kind = building_kind(building.name);
+
+            for(auto r = 0u; r < building.recipes.size(); ++r){
+                auto& recipe = building.recipes[r];
+                recipe_ids[b].emplace(recipe.recipe_name, int(r));
+
+                RecipeRef ref = {int(b), int(r)};
+                for(auto& item: recipe.outputs){
+                    recipes_of(producer_index, item.name).push_back(ref);
+                }
+                for(auto& item: recipe.inputs){
+                    recipes_of(consumer_index, item.name).push_back(ref);
+                }
+            }
         }
-        return -1;
     }
 
     std::vector<Building> buildings;
+    std::vector<std::string> items;
+    std::uint64_t            checksum = 0;  // of the JSON files loaded by load_configs
+    std::unordered_map<std::string, int> item_ids;
     std::unordered_map<std::string, std::shared_ptr<Image>> _texture_cache;
+
+private:
+    std::vector<RecipeRef> const& recipes_of(std::vector<std::vector<RecipeRef>> const& index, int item) const {
+        static std::vector<RecipeRef> const none;
+
+        if (item < 0 || std::size_t(item) >= index.size())
+            return none;
+        return index[std::size_t(item)];
+    }
+
+    std::vector<RecipeRef>& recipes_of(std::vector<std::vector<RecipeRef>>& index, std::string const& item){
+        auto id = std::size_t(add_item(item));
+        if (id >= index.size()){
+            index.resize(id + 1);
+        }
+        return index[id];
+    }
+
+    std::unordered_map<std::string, int>              building_ids;
+    std::vector<std::unordered_map<std::string, int>> recipe_ids;       // by building
+    std::vector<std::vector<RecipeRef>>               producer_index;   // by item
+    std::vector<std::vector<RecipeRef>>               consumer_index;
 };
 
 #endif
@@ -0,0 +1,1159 @@
+#include "forest.h"
+#include "tiled_save.h"
+#include "mapped_file.h"
+#include "lz.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Binary save, native endianness, every section starts on 8 bytes
+//
+//  SaveHeader
+//  uint32      string offsets [string_count + 1]   (in the string data)
+//  char        string data                         (building, recipe and item names)
+//  NodeRecord  nodes [node_count]
+//  LinkRecord  links [link_count]
+//  RuleRecord  rules [rule_count]
+//  TileRecord  tiles [tile_count]
+//
+// Nodes are grouped in square tiles by position, the nodes of a tile are contiguous.
+// The links inside a tile are grouped the same way, the links between two tiles
+// are at the end (crossing_links of them). A tile can be loaded on its own, see tiled_save.h
+// Pins are not saved, they are derived from the building layout.
+// Pins of a node have consecutive IDs, the pin IDs of the saving forest are
+// first_pin + slot; world files refer to pins by those IDs.
+// Node IDs of the saving forest are kept too, a save loaded into an empty forest
+// gets the node and pin IDs it was saved with; the autosave journal refers to them.
+// The generation is bumped by every journal compaction, see journal.h
+// The records are used in place from the mapped file, nothing is parsed
+//
+// Compressed saves wrap the same bytes in blocks compressed independently (lz.h)
+//
+//  PackHeader
+//  PackBlock   blocks [block_count]
+//  char        compressed data
+//
+// Every block but the last holds block_size bytes of the save, they are
+// decompressed in parallel before the save is read as above.
+// A block that does not compress is stored as is (size == raw_size).
+// Blocks are checked against the hash of their stored bytes first, a damaged
+// block fails to load instead of decompressing to different records
+namespace {
+
+constexpr char          save_magic[4] = {'P', 'Z', 'L', 'S'};
+constexpr std::uint32_t save_version  = 3;
+constexpr float         save_tile_size = 4096.f;
+
+struct SaveHeader {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint32_t string_count;
+    std::uint32_t string_bytes;
+    std::uint32_t node_count;
+    std::uint32_t link_count;
+    std::uint32_t rule_count;
+    std::uint32_t generation;
+    std::uint32_t tile_count;
+    std::uint32_t crossing_links;
+    std::uint32_t node_bound;       // node and pin IDs of the save are below
+    std::uint32_t pin_bound;
+    float         tile_size;
+    std::uint32_t reserved[3];
+};
+
+struct NodeRecord {
+    std::uint32_t id;
+    float         x;
+    float         y;
+    std::uint32_t first_pin;
+    std::int32_t  building;     // string index
+    std::int32_t  recipe;       // string index, -1 if none
+    std::int32_t  rotation;
+};
+
+struct LinkRecord {
+    std::uint32_t start;        // node index
+    std::uint32_t end;
+    std::uint8_t  start_slot;   // pin of the node
+    std::uint8_t  end_slot;
+    std::uint8_t  reserved[2];
+};
+
+struct RuleRecord {
+    std::uint32_t node;         // node index
+    std::uint8_t  output;       // output pin index
+    std::uint8_t  kind;         // SplitterRule::Kind
+    std::uint8_t  reserved[2];
+    std::int32_t  item;         // string index, -1 if none
+};
+
+constexpr char          pack_magic[4] = {'P', 'Z', 'L', 'Z'};
+constexpr std::uint32_t pack_version  = 2;
+constexpr std::uint32_t pack_block_size = 256 * 1024;
+
+struct PackHeader {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint64_t raw_size;     // size of the save once decompressed
+    std::uint32_t block_size;
+    std::uint32_t block_count;
+};
+
+struct PackBlock {
+    std::uint64_t offset;       // in the file
+    std::uint32_t size;
+    std::uint32_t raw_size;
+    std::uint64_t check;        // block_check of the stored bytes
+};
+
+struct TileRecord {
+    std::int32_t  x;            // tile coordinates, position / tile_size
+    std::int32_t  y;
+    std::uint32_t first_node;
+    std::uint32_t node_count;
+    std::uint32_t first_link;   // links between two nodes of the tile
+    std::uint32_t link_count;
+};
+
+std::int32_t tile_coord(float v, float size){
+    return std::int32_t(std::floor(v / size));
+}
+
+std::uint64_t tile_key(std::int32_t x, std::int32_t y){
+    return (std::uint64_t(std::uint32_t(x)) << 32) | std::uint32_t(y);
+}
+
+std::size_t aligned(std::size_t size){
+    return (size + 7) & ~std::size_t(7);
+}
+
+// Hash of a stored block, 8 bytes at a time so checking does not slow the load down
+std::uint64_t block_check(char const* data, std::size_t size){
+    std::uint64_t hash = size;
+    std::size_t i = 0;
+
+    auto mix = [&hash](std::uint64_t word){
+        hash = (std::rotl(hash, 5) ^ word) * 0x517cc1b727220a95ull;
+    };
+
+    for(; i + 8 <= size; i += 8){
+        std::uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        mix(word);
+    }
+
+    std::uint64_t tail = 0;
+    if (i < size){
+        std::memcpy(&tail, data + i, size - i);
+    }
+    mix(tail);
+    return hash;
+}
+
+bool packed(char const* data, std::size_t size){
+    return size >= sizeof(PackHeader) && std::memcmp(data, pack_magic, sizeof(pack_magic)) == 0;
+}
+
+// Compress a serialized save, one block per thread at a time
+std::vector<char> pack(std::vector<char> const& raw, unsigned threads = 0){
+    auto count = (raw.size() + pack_block_size - 1) / pack_block_size;
+    std::vector<std::vector<char>> blocks(count);
+
+    if (threads == 0){
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    parallel_for(count, std::clamp<std::size_t>(count, 1, threads), [&](std::size_t, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            auto offset = i * pack_block_size;
+            auto size = std::min<std::size_t>(pack_block_size, raw.size() - offset);
+
+            auto& block = blocks[i];
+            block.resize(lz::bound(size));
+            block.resize(lz::compress(raw.data() + offset, size, block.data()));
+
+            if (block.size() >= size){
+                block.assign(raw.data() + offset, raw.data() + offset + size);
+            }
+        }
+    });
+
+    PackHeader header = {};
+    std::memcpy(header.magic, pack_magic, sizeof(pack_magic));
+    header.version     = pack_version;
+    header.raw_size    = raw.size();
+    header.block_size  = pack_block_size;
+    header.block_count = std::uint32_t(count);
+
+    std::vector<PackBlock> index(count);
+    auto offset = sizeof(PackHeader) + count * sizeof(PackBlock);
+
+    for(auto i = 0u; i < count; ++i){
+        index[i] = {
+            offset,
+            std::uint32_t(blocks[i].size()),
+            std::uint32_t(std::min<std::size_t>(pack_block_size, raw.size() - i * pack_block_size)),
+            block_check(blocks[i].data(), blocks[i].size())
+        };
+        offset += blocks[i].size();
+    }
+
+    std::vector<char> data;
+    data.reserve(offset);
+
+    auto append = [&data](void const* src, std::size_t size){
+        data.insert(data.end(), static_cast<char const*>(src), static_cast<char const*>(src) + size);
+    };
+
+    append(&header, sizeof(header));
+    append(index.data(), index.size() * sizeof(PackBlock));
+    for(auto& block: blocks){
+        append(block.data(), block.size());
+    }
+    return data;
+}
+
+// Decompress the blocks holding the first prefix bytes of a compressed save
+// (all of them if prefix is 0) into raw, in parallel
+bool unpack(char const* data, std::size_t size, std::vector<char>& raw, std::size_t prefix = 0, unsigned threads = 0){
+    PackHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.version != pack_version || header.block_size == 0 || header.block_size > 64 * pack_block_size
+            || header.block_count != (header.raw_size + header.block_size - 1) / header.block_size
+            || header.block_count > (size - sizeof(PackHeader)) / sizeof(PackBlock)){
+        return false;
+    }
+
+    auto count = std::size_t(header.block_count);
+    auto raw_size = std::size_t(header.raw_size);
+
+    if (prefix > 0 && prefix < raw_size){
+        count = std::min(count, (prefix + header.block_size - 1) / header.block_size);
+        raw_size = std::min(raw_size, count * header.block_size);
+    }
+
+    std::vector<PackBlock> index(count);
+    if (count > 0){
+        std::memcpy(index.data(), data + sizeof(PackHeader), count * sizeof(PackBlock));
+    }
+
+    for(auto i = 0u; i < count; ++i){
+        auto& block = index[i];
+        auto expected = std::min<std::uint64_t>(header.block_size, header.raw_size - std::uint64_t(i) * header.block_size);
+
+        if (block.raw_size != expected || block.offset > size || block.size > size - block.offset)
+            return false;
+    }
+
+    raw.resize(raw_size);
+
+    if (threads == 0){
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    std::vector<char> failed(count, 0);
+
+    parallel_for(count, std::clamp<std::size_t>(count, 1, threads), [&](std::size_t, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            auto& block = index[i];
+            auto* src = data + block.offset;
+            auto* dst = raw.data() + i * header.block_size;
+
+            if (block_check(src, block.size) != block.check){
+                failed[i] = 1;
+            } else if (block.size == block.raw_size){
+                std::memcpy(dst, src, block.size);
+            } else if (!lz::decompress(src, block.size, dst, block.raw_size)){
+                failed[i] = 1;
+            }
+        }
+    });
+
+    return std::find(failed.begin(), failed.end(), 1) == failed.end();
+}
+
+// Byte offsets of the sections
+struct SaveLayout {
+    std::size_t offsets;
+    std::size_t strings;
+    std::size_t nodes;
+    std::size_t links;
+    std::size_t rules;
+    std::size_t tiles;
+    std::size_t size;
+
+    SaveLayout() = default;
+
+    SaveLayout(SaveHeader const& header){
+        offsets = aligned(sizeof(SaveHeader));
+        strings = offsets + aligned((std::size_t(header.string_count) + 1) * sizeof(std::uint32_t));
+        nodes   = strings + aligned(header.string_bytes);
+        links   = nodes + aligned(std::size_t(header.node_count) * sizeof(NodeRecord));
+        rules   = links + aligned(std::size_t(header.link_count) * sizeof(LinkRecord));
+        tiles   = rules + aligned(std::size_t(header.rule_count) * sizeof(RuleRecord));
+        size    = tiles + aligned(std::size_t(header.tile_count) * sizeof(TileRecord));
+    }
+};
+
+}
+
+// Everything needed to write a save, captured on the calling thread
+// so the forest can keep changing while the save is written
+struct SaveSnapshot {
+    std::vector<std::string> strings;
+    std::vector<NodeRecord>  nodes;
+    std::vector<LinkRecord>  links;
+    std::vector<RuleRecord>  rules;
+    std::vector<TileRecord>  tiles;
+    std::uint32_t            crossing_links = 0;
+    std::uint32_t            node_bound = 0;
+    std::uint32_t            pin_bound  = 0;
+    std::uint32_t            generation = 0;
+};
+
+// Mapped save with its header checked, compressed saves are decompressed first
+// names are resolved to buildings and recipes once per string, not once per node
+struct SaveFile {
+    MappedFile        file;
+    std::vector<char> unpacked;
+    char const*       data = nullptr;
+    std::size_t       size = 0;
+    SaveHeader const* header = nullptr;
+    SaveLayout        layout;
+
+    std::vector<int>                       buildings;
+    std::unordered_map<std::uint64_t, int> recipes;
+
+    SaveFile(std::string const& path, unsigned threads = 0):
+        file(path), data(file.data), size(file.size)
+    {
+        if (data != nullptr && packed(data, size)){
+            if (!unpack(file.data, file.size, unpacked, 0, threads)){
+                warn("{} is corrupted", path);
+                return;
+            }
+
+            data = unpacked.data();
+            size = unpacked.size();
+        }
+
+        if (data == nullptr || size < sizeof(SaveHeader)){
+            warn("File was not found:{} ", path);
+            return;
+        }
+
+        auto* h = at<SaveHeader>(0);
+
+        if (std::memcmp(h->magic, save_magic, sizeof(save_magic)) != 0 || h->version != save_version){
+            warn("{} is not a save (version {})", path, save_version);
+            return;
+        }
+
+        layout = SaveLayout(*h);
+        if (layout.size > size){
+            warn("{} is truncated", path);
+            return;
+        }
+
+        // the ID tables are sized by the bounds, a corrupted header must not make them huge
+        auto bound_cap = std::max<std::size_t>(layout.size, std::size_t(1) << 20);
+        if (h->node_bound > bound_cap || h->pin_bound > bound_cap){
+            warn("{} has invalid ID bounds", path);
+            return;
+        }
+
+        auto* offsets = at<std::uint32_t>(layout.offsets);
+        for(auto i = 0u; i < h->string_count; ++i){
+            if (offsets[i] > offsets[i + 1] || offsets[i + 1] > h->string_bytes){
+                warn("{} has invalid strings", path);
+                return;
+            }
+        }
+
+        header = h;
+        buildings.assign(header->string_count, -2);
+    }
+
+    bool valid() const {
+        return header != nullptr;
+    }
+
+    template<typename T>
+    T const* at(std::size_t offset) const {
+        return reinterpret_cast<T const*>(data + offset);
+    }
+
+    NodeRecord const* nodes() const { return at<NodeRecord>(layout.nodes); }
+    LinkRecord const* links() const { return at<LinkRecord>(layout.links); }
+    RuleRecord const* rules() const { return at<RuleRecord>(layout.rules); }
+    TileRecord const* tiles() const { return at<TileRecord>(layout.tiles); }
+
+    std::string name(std::int32_t i) const {
+        auto* offsets = at<std::uint32_t>(layout.offsets);
+
+        if (i < 0 || std::uint32_t(i) >= header->string_count || offsets[i + 1] > header->string_bytes)
+            return std::string();
+        return std::string(at<char>(layout.strings) + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    int building(std::int32_t i){
+        if (i < 0 || std::uint32_t(i) >= header->string_count)
+            return -1;
+
+        auto& building = buildings[std::size_t(i)];
+        if (building == -2){
+            building = Resources::instance().find_building(name(i));
+        }
+        return building;
+    }
+
+    int recipe(int building, std::int32_t i){
+        if (i < 0)
+            return -1;
+
+        auto key = (std::uint64_t(std::uint32_t(building)) << 32) | std::uint32_t(i);
+        auto found = recipes.find(key);
+
+        if (found == recipes.end()){
+            found = recipes.emplace(key, Resources::instance().find_recipe(building, name(i))).first;
+        }
+        return found->second;
+    }
+
+    // Arguments to create the node of a record, false if its building is unknown
+    // or its IDs are out of the bounds of the header
+    bool spec(std::uint32_t i, bool keep_ids, NodeSpec& out){
+        auto& record = nodes()[i];
+        auto b = building(record.building);
+
+        if (b < 0){
+            warn("Node {} has an unknown building {}", i, name(record.building));
+            return false;
+        }
+
+        auto pins = std::uint32_t(Resources::instance().buildings[std::size_t(b)].pin_count());
+        if (record.id == 0 || record.id >= header->node_bound
+            || pins > header->pin_bound || record.first_pin > header->pin_bound - pins){
+            warn("Node {} has invalid IDs", i);
+            return false;
+        }
+
+        out = {ImVec2(record.x, record.y), b, recipe(b, record.recipe), record.rotation};
+
+        if (keep_ids){
+            out.id = record.id;
+            out.first_pin = record.first_pin;
+        }
+        return true;
+    }
+
+    // The IDs of the nodes, and of their pins, do not overlap and can be kept
+    // records with an unknown building are not loaded and not checked
+    bool distinct_ids(){
+        auto& resources = Resources::instance().buildings;
+        auto* records = nodes();
+
+        std::vector<bool> used(header->node_bound, false);
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> pins;
+        pins.reserve(header->node_count);
+
+        for(auto i = 0u; i < header->node_count; ++i){
+            auto& record = records[i];
+            auto b = building(record.building);
+
+            if (b < 0 || record.id >= header->node_bound)
+                continue;
+
+            if (used[record.id])
+                return false;
+
+            used[record.id] = true;
+            pins.emplace_back(record.first_pin, std::uint64_t(record.first_pin) + resources[std::size_t(b)].pin_count());
+        }
+
+        std::sort(pins.begin(), pins.end());
+        for(auto i = 1u; i < pins.size(); ++i){
+            if (pins[i].first < pins[i - 1].second)
+                return false;
+        }
+        return true;
+    }
+
+    // Set the rules of the nodes in [first, last), node(i) is the node of the record i
+    // rules are sorted by node and the rules of a node are contiguous
+    template<typename NodeOf>
+    void load_rules(Forest& forest, std::uint32_t first, std::uint32_t last, NodeOf&& node){
+        auto* begin = rules();
+        auto* end = begin + header->rule_count;
+        auto* rule = std::lower_bound(begin, end, first, [](RuleRecord const& r, std::uint32_t n){ return r.node < n; });
+
+        while (rule != end && rule->node < last){
+            auto index = rule->node;
+            SplitterRules loaded;
+
+            for(; rule != end && rule->node == index; ++rule){
+                loaded.resize(std::size_t(rule->output) + 1);
+                auto kind = rule->kind <= SplitterRule::None ? SplitterRule::Kind(rule->kind) : SplitterRule::None;
+                loaded[rule->output] = {kind, name(rule->item)};
+            }
+
+            if (auto* n = node(index)){
+                forest.set_rules(n, loaded);
+            }
+        }
+    }
+};
+
+namespace {
+
+std::vector<char> serialize(SaveSnapshot const& snapshot){
+    SaveHeader header = {};
+    std::memcpy(header.magic, save_magic, sizeof(save_magic));
+    header.version      = save_version;
+    header.string_count = std::uint32_t(snapshot.strings.size());
+    header.node_count   = std::uint32_t(snapshot.nodes.size());
+    header.link_count   = std::uint32_t(snapshot.links.size());
+    header.rule_count   = std::uint32_t(snapshot.rules.size());
+    header.generation   = snapshot.generation;
+    header.tile_count   = std::uint32_t(snapshot.tiles.size());
+    header.crossing_links = snapshot.crossing_links;
+    header.node_bound   = snapshot.node_bound;
+    header.pin_bound    = snapshot.pin_bound;
+    header.tile_size    = save_tile_size;
+
+    std::vector<std::uint32_t> offsets;
+    offsets.reserve(snapshot.strings.size() + 1);
+    offsets.push_back(0);
+    for(auto& str: snapshot.strings){
+        offsets.push_back(offsets.back() + std::uint32_t(str.size()));
+    }
+    header.string_bytes = offsets.back();
+
+    SaveLayout layout(header);
+    std::vector<char> data(layout.size, 0);
+
+    auto copy = [&data](std::size_t offset, void const* src, std::size_t size){
+        if (size > 0){
+            std::memcpy(data.data() + offset, src, size);
+        }
+    };
+
+    copy(0, &header, sizeof(header));
+    copy(layout.offsets, offsets.data(), offsets.size() * sizeof(std::uint32_t));
+    for(auto i = 0u; i < snapshot.strings.size(); ++i){
+        copy(layout.strings + offsets[i], snapshot.strings[i].data(), snapshot.strings[i].size());
+    }
+    copy(layout.nodes, snapshot.nodes.data(), snapshot.nodes.size() * sizeof(NodeRecord));
+    copy(layout.links, snapshot.links.data(), snapshot.links.size() * sizeof(LinkRecord));
+    copy(layout.rules, snapshot.rules.data(), snapshot.rules.size() * sizeof(RuleRecord));
+    copy(layout.tiles, snapshot.tiles.data(), snapshot.tiles.size() * sizeof(TileRecord));
+    return data;
+}
+
+// Write to a temporary file next to path then rename it over path
+// a crash leaves either the previous save or the new one, never half of it
+bool write_atomic(std::string const& path, std::vector<char> const& data){
+    auto tmp = path + ".tmp";
+
+#ifdef __linux__
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0){
+        warn("File could not be created:{} ", tmp);
+        return false;
+    }
+
+    auto* ptr = data.data();
+    auto size = data.size();
+
+    while (size > 0){
+        auto n = ::write(fd, ptr, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0){
+            warn("Could not write {}: {}", tmp, std::strerror(errno));
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+
+        ptr += n;
+        size -= std::size_t(n);
+    }
+
+    if (::fsync(fd) != 0 || ::close(fd) != 0){
+        warn("Could not write {}: {}", tmp, std::strerror(errno));
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    if (::rename(tmp.c_str(), path.c_str()) != 0){
+        warn("Could not replace {}: {}", path, std::strerror(errno));
+        ::unlink(tmp.c_str());
+        return false;
+    }
+
+    // make the rename itself durable
+    auto dir = std::filesystem::path(path).parent_path().string();
+    int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0){
+        ::fsync(dir_fd);
+        ::close(dir_fd);
+    }
+    return true;
+#else
+    {
+        std::ofstream save_file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!save_file){
+            warn("File could not be created:{} ", tmp);
+            return false;
+        }
+
+        save_file.write(data.data(), std::streamsize(data.size()));
+        if (!save_file.flush()){
+            return false;
+        }
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmp, path, err);
+    return !err;
+#endif
+}
+
+}
+
+std::shared_ptr<SaveSnapshot> Forest::snapshot(std::uint32_t generation, std::function<bool(Node const*)> const& keep) const {
+    auto snapshot = std::make_shared<SaveSnapshot>();
+    snapshot->generation = generation;
+    std::unordered_map<std::string, std::int32_t> string_index;
+
+    auto intern = [&](std::string const& str) -> std::int32_t {
+        auto result = string_index.emplace(str, std::int32_t(snapshot->strings.size()));
+        if (result.second){
+            snapshot->strings.push_back(str);
+        }
+        return result.first->second;
+    };
+
+    // nodes are bucketed by tile
+    std::unordered_map<std::uint64_t, std::uint32_t> tile_index;
+    std::vector<std::vector<Node const*>>            tiled;
+
+    auto kept = [&keep](Node const* node){
+        return !keep || keep(node);
+    };
+
+    for(auto& node: nodes){
+        if (!kept(&node))
+            continue;
+
+        auto x = tile_coord(node.Pos.x, save_tile_size);
+        auto y = tile_coord(node.Pos.y, save_tile_size);
+        auto result = tile_index.emplace(tile_key(x, y), std::uint32_t(tiled.size()));
+
+        if (result.second){
+            tiled.emplace_back();
+            snapshot->tiles.push_back({x, y, 0, 0, 0, 0});
+        }
+        tiled[result.first->second].push_back(&node);
+    }
+
+    // row by row so neighbouring tiles are close in the file
+    std::vector<std::uint32_t> order(tiled.size());
+    for(auto i = 0u; i < order.size(); ++i){
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b){
+        auto& ta = snapshot->tiles[a];
+        auto& tb = snapshot->tiles[b];
+        return ta.y != tb.y ? ta.y < tb.y : ta.x < tb.x;
+    });
+
+    std::vector<TileRecord> tiles;
+    tiles.reserve(order.size());
+    snapshot->nodes.reserve(nodes.size());
+
+    IdMap<std::uint32_t> node_index;
+    std::vector<std::uint32_t> tile_of;
+    tile_of.reserve(nodes.size());
+
+    for(auto t: order){
+        auto tile = snapshot->tiles[t];
+        tile.first_node = std::uint32_t(snapshot->nodes.size());
+        tile.node_count = std::uint32_t(tiled[t].size());
+
+        for(auto* node: tiled[t]){
+            node_index.set(node->ID, std::uint32_t(snapshot->nodes.size()));
+            tile_of.push_back(std::uint32_t(tiles.size()));
+
+            auto first_pin = node->pins.size() > 0 ? node->pins.data()->ID : 0;
+            snapshot->node_bound = std::max(snapshot->node_bound, node->ID + 1);
+            snapshot->pin_bound = std::max(snapshot->pin_bound, first_pin + std::uint32_t(node->pins.size()));
+
+            auto* recipe = node->recipe();
+            snapshot->nodes.push_back({
+                node->ID,
+                node->Pos.x,
+                node->Pos.y,
+                first_pin,
+                intern(node->descriptor->name),
+                recipe != nullptr ? intern(recipe->recipe_name) : -1,
+                node->rotation
+            });
+
+            if (auto* rules = find_rules(node)){
+                for(auto i = 0u; i < rules->size(); ++i){
+                    auto& rule = (*rules)[i];
+                    snapshot->rules.push_back({
+                        std::uint32_t(snapshot->nodes.size() - 1),
+                        std::uint8_t(i),
+                        std::uint8_t(rule.kind),
+                        {0, 0},
+                        rule.kind == SplitterRule::Item ? intern(rule.item) : -1
+                    });
+                }
+            }
+        }
+        tiles.push_back(tile);
+    }
+
+    // links of a tile are contiguous (counting sort), crossing links at the end
+    auto crossing = std::uint32_t(tiles.size());
+    std::vector<std::uint32_t> link_tile;
+    std::vector<std::uint32_t> counts(tiles.size() + 1, 0);
+    link_tile.reserve(links.size());
+
+    for(auto& link: links){
+        if (!kept(link.start->parent) || !kept(link.end->parent))
+            continue;
+
+        auto s = tile_of[node_index.get(link.start->parent->ID)];
+        auto e = tile_of[node_index.get(link.end->parent->ID)];
+
+        link_tile.push_back(s == e ? s : crossing);
+        counts[link_tile.back()] += 1;
+    }
+
+    std::vector<std::uint32_t> next(tiles.size() + 1, 0);
+    for(auto t = 0u; t < tiles.size(); ++t){
+        tiles[t].first_link = next[t];
+        tiles[t].link_count = counts[t];
+        next[t + 1] = next[t] + counts[t];
+    }
+
+    snapshot->crossing_links = counts[crossing];
+    snapshot->links.resize(link_tile.size());
+
+    auto l = 0u;
+    for(auto& link: links){
+        if (!kept(link.start->parent) || !kept(link.end->parent))
+            continue;
+
+        snapshot->links[next[link_tile[l]]++] = {
+            node_index.get(link.start->parent->ID),
+            node_index.get(link.end->parent->ID),
+            std::uint8_t(link.start - link.start->parent->pins.data()),
+            std::uint8_t(link.end - link.end->parent->pins.data()),
+            {0, 0}
+        };
+        l += 1;
+    }
+
+    snapshot->tiles = std::move(tiles);
+    return snapshot;
+}
+
+bool Forest::write_snapshot(SaveSnapshot const& snapshot, std::string const& path, bool compressed){
+    if (compressed){
+        return write_atomic(path, pack(serialize(snapshot)));
+    }
+    return write_atomic(path, serialize(snapshot));
+}
+
+bool Forest::save_binary(std::string const& path, bool compressed) const {
+    return write_snapshot(*snapshot(), path, compressed);
+}
+
+bool Forest::is_compressed_save(std::string const& path){
+    char magic[sizeof(PackHeader)] = {};
+    std::ifstream save_file(path, std::ios::in | std::ios::binary);
+
+    return save_file.read(magic, sizeof(magic)) && packed(magic, sizeof(magic));
+}
+
+std::uint32_t Forest::save_generation(std::string const& path){
+    SaveHeader header = {};
+    MappedFile file(path);
+
+    if (file.data == nullptr)
+        return 0;
+
+    // only the first block of a compressed save is needed
+    if (packed(file.data, file.size)){
+        std::vector<char> raw;
+
+        if (!unpack(file.data, file.size, raw, sizeof(SaveHeader), 1) || raw.size() < sizeof(header))
+            return 0;
+        std::memcpy(&header, raw.data(), sizeof(header));
+    } else if (file.size >= sizeof(header)){
+        std::memcpy(&header, file.data, sizeof(header));
+    } else {
+        return 0;
+    }
+
+    if (std::memcmp(header.magic, save_magic, sizeof(save_magic)) != 0 || header.version != save_version)
+        return 0;
+
+    return header.generation;
+}
+
+bool Forest::load_binary(std::string const& path, PinRemap* pins, unsigned threads){
+    SaveFile save(path, threads);
+
+    if (!save.valid()){
+        return false;
+    }
+
+    auto& header = *save.header;
+    auto* records = save.nodes();
+
+    // names are resolved on this thread, the nodes are constructed in parallel
+    std::vector<NodeSpec>      specs;
+    std::vector<std::uint32_t> record_of;
+
+    // the journal refers to the nodes by the IDs of the save
+    bool keep_ids = node_count() == 0;
+
+    if (keep_ids && !save.distinct_ids()){
+        warn("{} has duplicate IDs, the nodes get new ones", path);
+        keep_ids = false;
+    }
+    specs.reserve(header.node_count);
+    record_of.reserve(header.node_count);
+
+    for(auto i = 0u; i < header.node_count; ++i){
+        NodeSpec spec;
+
+        if (save.spec(i, keep_ids, spec)){
+            specs.push_back(spec);
+            record_of.push_back(i);
+        }
+    }
+
+    begin_batch();
+
+    std::vector<Node*> loaded;
+    new_nodes(specs, loaded, threads);
+
+    // node index in the file to node
+    std::vector<Node*> created(header.node_count, nullptr);
+    for(auto i = 0u; i < loaded.size(); ++i){
+        created[record_of[i]] = loaded[i];
+    }
+
+    if (pins != nullptr){
+        pins->reserve(header.pin_bound);
+
+        parallel_for(loaded.size(), parallel_chunks(loaded.size(), threads), [&](std::size_t, std::size_t begin, std::size_t end){
+            for(auto i = begin; i < end; ++i){
+                auto all = loaded[i]->pins.all();
+                auto first = records[record_of[i]].first_pin;
+
+                for(auto k = 0u; k < all.size(); ++k){
+                    pins->set(first + k, &all[k]);
+                }
+            }
+        });
+    }
+
+    auto pin = [&](std::uint32_t node, std::uint8_t slot) -> Pin const* {
+        if (node >= created.size() || created[node] == nullptr || slot >= created[node]->pins.size())
+            return nullptr;
+        return &created[node]->pins.all()[slot];
+    };
+
+    // second pass, links
+    auto* link_records = save.links();
+    std::vector<std::pair<Pin const*, Pin const*>> ends(header.link_count);
+
+    parallel_for(ends.size(), parallel_chunks(ends.size(), threads), [&](std::size_t, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            auto& record = link_records[i];
+            ends[i] = {pin(record.start, record.start_slot), pin(record.end, record.end_slot)};
+        }
+    });
+
+    auto connected = std::remove_if(ends.begin(), ends.end(), [](auto const& link){
+        return link.first == nullptr || link.second == nullptr;
+    });
+
+    if (connected != ends.end()){
+        warn("{} links are not connected", ends.end() - connected);
+        ends.erase(connected, ends.end());
+    }
+
+    new_links(ends, threads);
+
+    commit();
+
+    save.load_rules(*this, 0, header.node_count, [&](std::uint32_t i){ return created[i]; });
+    return true;
+}
+
+TiledSave::TiledSave(Forest& forest, std::string const& path):
+    forest(forest), save(std::make_unique<SaveFile>(path))
+{
+    if (!save->valid()){
+        return;
+    }
+
+    if (!check()){
+        warn("{} has invalid tiles", path);
+        save->header = nullptr;
+        return;
+    }
+
+    auto& header = *save->header;
+    auto* tiles = save->tiles();
+    tile_size = header.tile_size;
+
+    // the nodes keep the IDs of the save, the ones created in the meantime must not take them
+    forest.clear();
+    forest.skip_ids(header.node_bound, header.pin_bound, 0);
+
+    resident.assign(header.tile_count, false);
+    remaining = header.tile_count;
+
+    for(auto t = 0u; t < header.tile_count; ++t){
+        tile_index[tile_key(tiles[t].x, tiles[t].y)] = t;
+    }
+
+    // crossing links of each tile
+    auto* links = save->links();
+    auto first = header.link_count - header.crossing_links;
+    crossing_offsets.assign(header.tile_count + 1, 0);
+
+    for(auto l = first; l < header.link_count; ++l){
+        crossing_offsets[tile_of(links[l].start) + 1] += 1;
+        crossing_offsets[tile_of(links[l].end) + 1] += 1;
+    }
+
+    for(auto t = 0u; t < header.tile_count; ++t){
+        crossing_offsets[t + 1] += crossing_offsets[t];
+    }
+
+    crossing.resize(crossing_offsets.back());
+    auto next = crossing_offsets;
+
+    for(auto l = first; l < header.link_count; ++l){
+        crossing[next[tile_of(links[l].start)]++] = l;
+        crossing[next[tile_of(links[l].end)]++] = l;
+    }
+}
+
+TiledSave::~TiledSave() = default;
+
+bool TiledSave::check() const {
+    auto& header = *save->header;
+    auto* tiles = save->tiles();
+    auto* links = save->links();
+
+    if (!std::isfinite(header.tile_size) || header.tile_size <= 0.f || header.crossing_links > header.link_count)
+        return false;
+
+    // the nodes and the links of the tiles are contiguous and in order, crossing links at the end
+    std::uint64_t next_node = 0;
+    std::uint64_t next_link = 0;
+
+    for(auto t = 0u; t < header.tile_count; ++t){
+        if (tiles[t].first_node != next_node || tiles[t].first_link != next_link)
+            return false;
+
+        next_node += tiles[t].node_count;
+        next_link += tiles[t].link_count;
+    }
+
+    if (next_node != header.node_count || next_link != header.link_count - header.crossing_links)
+        return false;
+
+    for(auto l = 0u; l < header.link_count; ++l){
+        if (links[l].start >= header.node_count || links[l].end >= header.node_count)
+            return false;
+    }
+
+    // the nodes are created with the IDs of the save
+    return save->distinct_ids();
+}
+
+bool TiledSave::valid() const {
+    return save->valid();
+}
+
+std::uint32_t TiledSave::tile_of(std::uint32_t node) const {
+    auto* begin = save->tiles();
+    auto* end = begin + save->header->tile_count;
+
+    auto tile = std::upper_bound(begin, end, node, [](std::uint32_t n, TileRecord const& t){
+        return n < t.first_node;
+    });
+    return std::uint32_t(tile - begin) - 1;
+}
+
+Box TiledSave::bounds(std::uint32_t tile) const {
+    auto& record = save->tiles()[tile];
+    auto min = ImVec2(float(record.x) * tile_size, float(record.y) * tile_size);
+    return {min, min + ImVec2(tile_size, tile_size)};
+}
+
+std::size_t TiledSave::load(Box const& region){
+    if (!valid())
+        return 0;
+
+    focus = (region.min + region.max) * 0.5f;
+
+    // nodes belong to the tile of their top left corner but can stick out of it
+    auto margin = tile_size * 0.25f;
+    auto x0 = tile_coord(region.min.x - margin, tile_size);
+    auto y0 = tile_coord(region.min.y - margin, tile_size);
+    auto x1 = tile_coord(region.max.x, tile_size);
+    auto y1 = tile_coord(region.max.y, tile_size);
+
+    std::size_t loaded = 0;
+    for(auto y = y0; y <= y1; ++y){
+        for(auto x = x0; x <= x1; ++x){
+            auto found = tile_index.find(tile_key(x, y));
+
+            if (found != tile_index.end() && !resident[found->second]){
+                load_tile(found->second);
+                loaded += 1;
+            }
+        }
+    }
+    return loaded;
+}
+
+std::size_t TiledSave::load_next(std::size_t count){
+    std::size_t loaded = 0;
+
+    for(; loaded < count && remaining > 0; ++loaded){
+        // closest tile to the last region requested
+        std::uint32_t best = 0;
+        float best_distance = std::numeric_limits<float>::max();
+
+        for(auto t = 0u; t < resident.size(); ++t){
+            if (resident[t])
+                continue;
+
+            auto box = bounds(t);
+            auto d = (box.min + box.max) * 0.5f - focus;
+            auto distance = d.x * d.x + d.y * d.y;
+
+            if (distance < best_distance){
+                best = t;
+                best_distance = distance;
+            }
+        }
+        load_tile(best);
+    }
+    return loaded;
+}
+
+void TiledSave::load_all(){
+    for(auto t = 0u; t < resident.size(); ++t){
+        if (!resident[t]){
+            load_tile(t);
+        }
+    }
+}
+
+std::vector<Box> TiledSave::missing() const {
+    std::vector<Box> boxes;
+
+    for(auto t = 0u; t < resident.size(); ++t){
+        if (!resident[t]){
+            boxes.push_back(bounds(t));
+        }
+    }
+    return boxes;
+}
+
+void TiledSave::load_tile(std::uint32_t t){
+    resident[t] = true;
+    remaining -= 1;
+
+    auto& tile = save->tiles()[t];
+    auto* records = save->nodes();
+    auto* links = save->links();
+
+    std::vector<NodeSpec> specs;
+    specs.reserve(tile.node_count);
+
+    for(auto i = tile.first_node; i < tile.first_node + tile.node_count; ++i){
+        NodeSpec spec;
+
+        if (save->spec(i, true, spec)){
+            specs.push_back(spec);
+        }
+    }
+
+    // nodes are found by the ID they were saved with, the ones of the tiles
+    // not loaded yet or removed since do not exist
+    auto node = [&](std::uint32_t i) -> Node* {
+        return forest.find_node(records[i].id);
+    };
+
+    auto pin = [&](std::uint32_t i, std::uint8_t slot) -> Pin const* {
+        auto* n = node(i);
+        if (n == nullptr || slot >= n->pins.size())
+            return nullptr;
+        return &n->pins.all()[slot];
+    };
+
+    forest.begin_batch();
+
+    std::vector<Node*> created;
+    forest.new_nodes(specs, created);
+
+    std::vector<std::pair<Pin const*, Pin const*>> ends;
+    ends.reserve(tile.link_count);
+
+    for(auto l = tile.first_link; l < tile.first_link + tile.link_count; ++l){
+        auto* s = pin(links[l].start, links[l].start_slot);
+        auto* e = pin(links[l].end, links[l].end_slot);
+
+        if (s != nullptr && e != nullptr){
+            ends.emplace_back(s, e);
+        }
+    }
+
+    // links to the tiles already loaded, unless the pins were connected in the meantime
+    for(auto c = crossing_offsets[t]; c < crossing_offsets[t + 1]; ++c){
+        auto& link = links[crossing[c]];
+        auto* s = pin(link.start, link.start_slot);
+        auto* e = pin(link.end, link.end_slot);
+
+        if (s != nullptr && e != nullptr && forest.find_link(s) == nullptr && forest.find_link(e) == nullptr){
+            ends.emplace_back(s, e);
+        }
+    }
+
+    forest.new_links(ends);
+    forest.commit();
+
+    save->load_rules(forest, tile.first_node, tile.first_node + tile.node_count, node);
+}
@@ -0,0 +1,107 @@
+#include "clipboard.h"
+#include "node-editor.h"
+
+void Clipboard::copy(Forest& forest, std::vector<Node*> const& selection){
+    clear();
+
+    if (selection.empty())
+        return;
+
+    index.reset();
+
+    Box bb = Forest::bounds(selection[0]);
+    for(auto* node: selection){
+        auto box = Forest::bounds(node);
+        bb.min = ImVec2(std::min(bb.min.x, box.min.x), std::min(bb.min.y, box.min.y));
+        bb.max = ImVec2(std::max(bb.max.x, box.max.x), std::max(bb.max.y, box.max.y));
+    }
+
+    nodes.reserve(selection.size());
+    for(auto* node: selection){
+        index[node->ID] = std::uint32_t(nodes.size()) + 1;
+        auto* rules = forest.find_rules(node);
+        nodes.push_back({node->Pos - bb.min, node->building, node->recipe_idx, node->rotation,
+                         rules != nullptr ? *rules : SplitterRules()});
+    }
+
+    // links are found from their start pin so they are only copied once
+    for(auto* node: selection){
+        auto pins = node->pins.all();
+
+        for(std::size_t i = 0; i < pins.size(); ++i){
+            auto* link = forest.find_link(&pins[i]);
+            if (link == nullptr || link->start != &pins[i])
+                continue;
+
+            auto* end = link->end->parent;
+            if (!index.has(end->ID))
+                continue;
+
+            links.push_back({
+                index[node->ID] - 1,
+                index[end->ID] - 1,
+                std::uint8_t(i),
+                std::uint8_t(link->end - end->pins.data())
+            });
+        }
+    }
+
+    size = bb.max - bb.min;
+}
+
+std::vector<Node*> const& Clipboard::paste(History& history, ImVec2 origin, int count){
+    // one grid cell between copies
+    auto step = snap(ImVec2(0, size.y + 20.f));
+    return paste(history, origin, step, count);
+}
+
+std::vector<Node*> const& Clipboard::paste(History& history, ImVec2 origin, ImVec2 offset, int count){
+    auto& forest = history.graph();
+    created.clear();
+
+    if (empty() || count <= 0)
+        return created;
+
+    auto copies = std::size_t(count);
+    specs.clear();
+    specs.reserve(nodes.size() * copies);
+
+    for(std::size_t c = 0; c < copies; ++c){
+        auto base = origin + offset * float(c);
+
+        for(auto& n: nodes){
+            specs.push_back({base + n.pos, n.building, n.recipe, n.rotation});
+        }
+    }
+
+    history.begin_step();
+    forest.begin_batch();
+
+    history.new_nodes(specs, created);
+
+    for(std::size_t i = 0; i < created.size(); ++i){
+        auto& rules = nodes[i % nodes.size()].rules;
+        if (!rules.empty()){
+            history.set_rules(created[i], rules);
+        }
+    }
+
+    ends.clear();
+    ends.reserve(links.size() * copies);
+
+    for(std::size_t c = 0; c < copies; ++c){
+        auto first = c * nodes.size();
+
+        for(auto& l: links){
+            ends.emplace_back(
+                &created[first + l.start]->pins.all()[l.start_slot],
+                &created[first + l.end]->pins.all()[l.end_slot]);
+        }
+    }
+
+    history.new_links(ends);
+
+    forest.commit();
+    history.end_step();
+    return created;
+}
@@ -0,0 +1,64 @@
+#ifndef PUZZLE_EDITOR_CLIPBOARD_HEADER
+#define PUZZLE_EDITOR_CLIPBOARD_HEADER
+
+#include "history.h"
+
+#include <vector>
+
+// Copy of a subgraph (nodes and the links between them)
+// Nodes are stored relative to the top left corner of the selection and
+// links refer to nodes by their index in the clipboard, so pasting does not
+// need any ID lookup, only an array of the nodes created
+struct Clipboard {
+    struct NodeRecord {
+        ImVec2        pos;
+        std::int32_t  building;
+        std::int32_t  recipe;
+        std::int32_t  rotation;
+        SplitterRules rules;
+    };
+
+    struct LinkRecord {
+        std::uint32_t start;        // index of the node in the clipboard
+        std::uint32_t end;
+        std::uint8_t  start_slot;   // index of the pin in its node
+        std::uint8_t  end_slot;
+    };
+
+    // Replace the content of the clipboard with the selected nodes
+    // only the links between selected nodes are copied
+    void copy(Forest& forest, std::vector<Node*> const& selection);
+
+    // Insert count copies, the first one at origin (top left corner)
+    // the following ones are placed below each other.
+    // All the copies are inserted in a single batch and a single undo step.
+    // Returns the nodes created
+    std::vector<Node*> const& paste(History& history, ImVec2 origin, int count = 1);
+
+    // Same as above but the copies are placed origin + i * offset
+    std::vector<Node*> const& paste(History& history, ImVec2 origin, ImVec2 offset, int count);
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    void clear(){
+        nodes.clear();
+        links.clear();
+        size = ImVec2(0, 0);
+    }
+
+    std::vector<NodeRecord> nodes;
+    std::vector<LinkRecord> links;
+    ImVec2                  size;   // size of the bounding box of the nodes
+
+private:
+    StampedArray<std::uint32_t> index;      // node ID to clipboard index + 1
+    std::vector<Node*>          created;
+
+    // Bulk insertion buffers, kept between pastes
+    std::vector<NodeSpec>                           specs;
+    std::vector<std::pair<Pin const*, Pin const*>> ends;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef PUZZLE_EDITOR_COMPONENTS_HEADER
+#define PUZZLE_EDITOR_COMPONENTS_HEADER
+
+#include "traversal.h"
+
+#include <cstdint>
+#include <vector>
+
+struct Node;
+
+// Connected components of the forest (production lines)
+// Links are absorbed by a union-find in near constant time.
+// Removals cannot be undone by a union-find, instead the endpoints of the
+// removed connection are recorded and only the components they belonged to
+// are rebuilt, lazily, on the next query.
+//
+// Each component has a label that is stable: a union keeps the label of the
+// largest component and a split keeps it for the part found first
+struct Components {
+    // A new node is a component on its own
+    // Deleted nodes do not need to be removed, their links are removed
+    // first and IDs are not reused so their slot simply becomes unreachable
+    void add(std::uint32_t node){
+        if (node >= parent.size()){
+            auto n = std::max<std::size_t>(node + 1, parent.size() * 2);
+            parent.resize(n, 0);
+            sizes.resize(n, 0);
+            labels.resize(n, 0);
+        }
+
+        parent[node] = node;
+        sizes[node]  = 1;
+        labels[node] = next_label++;
+    }
+
+    // A link was created between a and b
+    void unite(std::uint32_t a, std::uint32_t b){
+        a = find(a);
+        b = find(b);
+
+        if (a == b)
+            return;
+
+        if (sizes[a] < sizes[b])
+            std::swap(a, b);
+
+        parent[b] = a;
+        sizes[a] += sizes[b];
+    }
+
+    // The link between a and b was removed
+    void split(std::uint32_t a, std::uint32_t b){
+        seeds.push_back(a);
+        seeds.push_back(b);
+    }
+
+    std::uint32_t find(std::uint32_t node){
+        auto root = node;
+        while (parent[root] != root){
+            root = parent[root];
+        }
+
+        // path compression
+        while (parent[node] != root){
+            auto next = parent[node];
+            parent[node] = root;
+            node = next;
+        }
+        return root;
+    }
+
+    // Stable ID of the component of the node
+    std::uint32_t label(std::uint32_t node){
+        return labels[find(node)];
+    }
+
+    bool dirty() const {
+        return seeds.size() > 0;
+    }
+
+    void clear(){
+        parent.clear();
+        sizes.clear();
+        labels.clear();
+        seeds.clear();
+        next_label = 1;
+    }
+
+    // Recompute the components that were split
+    // lookup(id) returns the Node* with that ID (or nullptr if it was removed)
+    // neighbors(node, fun) calls fun on every node connected to node
+    template<typename Lookup, typename Neighbors>
+    void rebuild(Lookup&& lookup, Neighbors&& neighbors){
+        if (!dirty())
+            return;
+
+        // labels before the split, they need to be read before
+        // parents are overridden
+        old_labels.clear();
+        for(auto seed: seeds){
+            old_labels.push_back(label(seed));
+        }
+
+        visited.reset();
+        reused.reset();
+
+        for(std::size_t i = 0; i < seeds.size(); ++i){
+            auto* start = lookup(seeds[i]);
+
+            if (start == nullptr || !visited.visit(start->ID))
+                continue;
+
+            auto root = start->ID;
+            std::uint32_t count = 0;
+
+            queue.clear();
+            queue.push_back(start);
+
+            while (!queue.empty()){
+                auto* node = queue.pop_front();
+                parent[node->ID] = root;
+                count += 1;
+
+                neighbors(node, [this](auto* next){
+                    if (visited.visit(next->ID)){
+                        queue.push_back(next);
+                    }
+                });
+            }
+
+            sizes[root] = count;
+
+            // first part keeps the label
+            auto old = old_labels[i];
+            if (old != 0 && reused.visit(old)){
+                labels[root] = old;
+            } else {
+                labels[root] = next_label++;
+            }
+        }
+
+        seeds.clear();
+    }
+
+private:
+    std::vector<std::uint32_t> parent;
+    std::vector<std::uint32_t> sizes;
+    std::vector<std::uint32_t> labels;
+    std::uint32_t              next_label = 1;
+
+    // Rebuild
+    std::vector<std::uint32_t> seeds;
+    std::vector<std::uint32_t> old_labels;
+    VisitedSet                 visited;
+    VisitedSet                 reused;
+    RingQueue<Node*>           queue;
+};
+
+#endif
@@ -12,7 +12,7 @@ void from_json(const json& j, ImVec2& v){
     v.y = data[1];
 }
 
-using IDRemaper = std::unordered_map<std::size_t, void*>;
+using IDRemaper = PinRemap;
 
 // we only need id
 void to_json(json& j, const Pin& p){
@@ -20,13 +20,25 @@ void to_json(json& j, const Pin& p){
         {"id", p.ID},
         {"type", p.belt_type},
         {"input", p.is_input},
-        {"side", p.side},
-        {"index", p.index},
-        {"count", p.count},
+        {"side", int(p.side)},
+        {"index", int(p.index)},
+        {"count", int(p.count)},
         {"parent", p.parent->ID},
     };
 }
 
+void to_json(json& j, const NodePins& pins){
+    j = json::array();
+
+    for(auto& side: pins){
+        json& jside = j.emplace_back(json::array());
+
+        for(auto& pin: side){
+            jside.push_back(pin);
+        }
+    }
+}
+
 void to_json(json& j, const Node& n){
     std::string bname = "";
     std::string rname = "";
@@ -50,6 +62,19 @@ void to_json(json& j, const Node& n){
     };
 }
 
+void to_json(json& j, const SplitterRule& r){
+    j = json{{"kind", r.kind}};
+
+    if (r.kind == SplitterRule::Item){
+        j["item"] = r.item;
+    }
+}
+
+void from_json(const json& j, SplitterRule& r){
+    j.at("kind").get_to(r.kind);
+    r.item = j.value("item", "");
+}
+
 void to_json(json& j, const NodeLink& l){
     j = json{
         {"start", l.start->ID},
@@ -59,8 +84,18 @@ void to_json(json& j, const NodeLink& l){
 
 
 void to_json(json& j, const Forest& n){
+    json nodes = json::array();
+
+    for(auto& node: n.nodes){
+        json& jnode = nodes.emplace_back(node);
+
+        if (auto* rules = n.find_rules(&node)){
+            jnode["rules"] = *rules;
+        }
+    }
+
     j = json{
-        {"nodes", n.nodes},
+        {"nodes", nodes},
         {"links", n.links}
     };
 }
@@ -87,37 +122,40 @@ void from_json(const json& j, Forest& f, IDRemaper& remap){
 
     // add pins to remap
     for(auto i = 0u; i < 4u; ++i){
-        auto& new_side = n->pins[i];
+        auto new_side = n->pins[i];
         auto& old_side = old_pins[i];
 
         assertf(new_side.size() == old_side.size(), "Side must match");
         for(auto k = 0u; k < new_side.size(); ++k){
             assertf(old_side[k].is_object(), "should be pin object");
 
-            auto old_id = old_side[k].at("id").get<std::size_t>();
-            remap[old_id] = reinterpret_cast<void*>(&new_side[k]);
+            auto old_id = old_side[k].at("id").get<std::uint32_t>();
+            remap.set(old_id, &new_side[k]);
         }
     }
 
-    // save the old => new id for links
-    remap[j.at("id").get<std::size_t>()] = reinterpret_cast<void*>(n);
+    if (j.contains("rules")){
+        f.set_rules(n, j.at("rules").get<SplitterRules>());
+    }
 }
 
 void from_json_link(const json& j, Forest& f, IDRemaper& remap){
-    auto start_id = j.at("start").get<std::size_t>();
-    auto end_id = j.at("end").get<std::size_t>();
+    auto start = remap.get(j.at("start").get<std::uint32_t>());
+    auto end = remap.get(j.at("end").get<std::uint32_t>());
 
-    void* start_pin = remap.at(start_id);
-    void* end_pin = remap.at(end_id);
+    if (start == nullptr || end == nullptr){
+        warn("Link is not connected");
+        return;
+    }
 
-    f.new_link(reinterpret_cast<Pin const*>(start_pin),
-               reinterpret_cast<Pin const*>(end_pin));
+    f.new_link(start, end);
 }
 
-void from_json(const json& j, Forest& n){
-    IDRemaper remap_id;
+static void load_forest(const json& j, Forest& n, IDRemaper& remap_id){
     assertf(j.is_object(), "Expect j to be a forest object");
 
+    n.begin_batch();
+
     auto nodes = j.at("nodes").get<std::vector<json>>();
     for(auto& jnode: nodes){
         assertf(jnode.is_object(), "Should be a node object");
@@ -129,56 +167,218 @@ void from_json(const json& j, Forest& n){
         assertf(jlink.is_object(), "Should be a link object");
         from_json_link(jlink, n, remap_id);
     }
+
+    n.commit();
 }
 
-void Forest::save(std::string const& filename, bool override){
+void from_json(const json& j, Forest& n){
+    IDRemaper remap_id;
+    load_forest(j, n, remap_id);
+}
+
+bool Forest::export_json(std::string const& filename, bool override){
     auto path = puzzle::binary_path() + "/saves/" + filename + ".json";
 
     if (std::filesystem::exists(path) && !override){
          warn("File exist:{} ", path);
-         return;
+         return false;
     }
 
     std::ofstream save_file(path, std::ios::out | std::ios::binary);
 
     if (!save_file){
         warn("File was not found:{} ", path);
-        return;
+        return false;
     }
 
+    // "nodes" before "links" so the import creates the links as it reads them,
+    // json objects write their keys in alphabetical order
     json forest = *this;
-    save_file << forest;
+    save_file << "{\"nodes\":" << forest["nodes"] << ",\"links\":" << forest["links"] << "}";
+    return bool(save_file);
 }
 
 void Forest::clear(){
     nodes.clear();
     links.clear();
     lookup.clear();
+    node_lookup.clear();
+    ports.clear();
+    splitter_rules.clear();
+    components.clear();
+    reach.clear();
+    spatial.clear();
+    pending_nodes.clear();
+    pending_links.clear();
+    node_ids.reset();
+    pin_ids.reset();
+    link_ids.reset();
+    modified();
 }
 
+void Forest::apply_pending(){
+    if (pending_nodes.size() + pending_links.size() == 0){
+        return;
+    }
 
-void Forest::load(std::string const& filename, bool clear){
-    auto path = puzzle::binary_path() + "/saves/" + filename + ".json";
-    std::ifstream save_file(path, std::ios::in | std::ios::binary);
+    parallel_for(pending_nodes.size(), parallel_chunks(pending_nodes.size()), [this](std::size_t, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            pending_nodes[i]->logic = fetch_logic(this, pending_nodes[i]);
+        }
+    });
+
+    lookup.reserve(pin_ids.bound());
+
+    // superseded links are removed in one scan of the list once the batch is applied
+    removed_links.reset();
+    bool superseded = false;
+
+    for(auto* link: pending_links){
+        // a pin can only be connected once, the last connection wins
+        for(auto* pin: {link->end, link->start}){
+            NodeLink* old = lookup.get(pin->ID);
+
+            if (old != nullptr){
+                lookup.erase(old->start->ID);
+                lookup.erase(old->end->ID);
+                components.split(old->start->parent->ID, old->end->parent->ID);
+                reach.unlinked(old->start, old->end);
+                removed_links.visit(old->ID);
+                superseded = true;
+            }
+        }
 
-    if (!save_file){
-        warn("File was not found:{} ", path);
-        return;
+        lookup.set(link->start->ID, link);
+        lookup.set(link->end->ID, link);
+        components.unite(link->start->parent->ID, link->end->parent->ID);
+        reach.linked(link->start, link->end);
+        link->logic = fetch_logic(this, link);
+    }
+
+    if (superseded){
+        links.remove_if([this](NodeLink const& link){ return removed_links.visited(link.ID); });
+    }
+
+    pending_nodes.clear();
+    pending_links.clear();
+    modified();
+}
+
+
+void Forest::new_nodes(std::vector<NodeSpec> const& specs, std::vector<Node*>& out, unsigned threads){
+    assertf(in_batch(), "bulk insertions are done inside a batch");
+
+    // pins of a node get consecutive IDs
+    auto& buildings = Resources::instance().buildings;
+    std::vector<std::uint32_t> pin_counts(buildings.size(), ~0u);
+    std::vector<std::uint32_t> first_pins(specs.size() + 1, 0);
+
+    for(auto i = 0u; i < specs.size(); ++i){
+        auto& count = pin_counts[std::size_t(specs[i].building)];
+        if (count == ~0u){
+            count = std::uint32_t(buildings[std::size_t(specs[i].building)].pin_count());
+        }
+        first_pins[i + 1] = first_pins[i] + count;
+    }
+
+    std::uint32_t node_base = 0;
+    std::uint32_t pin_base  = 0;
+    bool keep = specs.size() > 0 && specs[0].id != 0;
+
+    if (keep){
+        std::uint32_t node_bound = 0;
+        std::uint32_t pin_bound  = 0;
+
+        for(auto i = 0u; i < specs.size(); ++i){
+            assertf(specs[i].id != 0, "either all the specs or none have an ID");
+            node_bound = std::max(node_bound, specs[i].id + 1);
+            pin_bound  = std::max(pin_bound, specs[i].first_pin + first_pins[i + 1] - first_pins[i]);
+        }
+
+        node_ids.skip(node_bound);
+        pin_ids.skip(pin_bound);
+    } else {
+        node_base = node_ids.reserve(std::uint32_t(specs.size()));
+        pin_base = pin_ids.reserve(first_pins.back());
+    }
+
+    // lookup entries are distinct and set without reallocation
+    node_lookup.reserve(node_ids.bound());
+    out.resize(specs.size());
+
+    // list nodes are allocated by each thread then spliced, the pointers stay valid
+    auto chunks = parallel_chunks(specs.size(), threads);
+    std::vector<std::list<Node>> created(chunks);
+
+    parallel_for(specs.size(), chunks, [&](std::size_t k, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            auto& spec = specs[i];
+            auto& node = created[k].emplace_back(
+                keep ? spec.id : node_base + std::uint32_t(i),
+                keep ? spec.first_pin : pin_base + first_pins[i],
+                spec.building, spec.pos, spec.recipe, spec.rotation);
+
+            out[i] = &node;
+            node_lookup.set(node.ID, &node);
+        }
+    });
+
+    for(auto& chunk: created){
+        nodes.splice(nodes.end(), chunk);
+    }
+
+    pending_nodes.reserve(pending_nodes.size() + out.size());
+    for(auto* node: out){
+        components.add(node->ID);
+        spatial.insert(node->ID, bounds(node));
+        pending_nodes.push_back(node);
+    }
+}
+
+void Forest::new_links(std::vector<std::pair<Pin const*, Pin const*>> const& ends, unsigned threads){
+    assertf(in_batch(), "bulk insertions are done inside a batch");
+
+    auto base = link_ids.reserve(std::uint32_t(ends.size()));
+    auto chunks = parallel_chunks(ends.size(), threads);
+    std::vector<std::list<NodeLink>> created(chunks);
+
+    auto first = pending_links.size();
+    pending_links.resize(first + ends.size());
+
+    parallel_for(ends.size(), chunks, [&](std::size_t k, std::size_t begin, std::size_t end){
+        for(auto i = begin; i < end; ++i){
+            pending_links[first + i] = &created[k].emplace_back(base + std::uint32_t(i), ends[i].first, ends[i].second);
+        }
+    });
+
+    for(auto& chunk: created){
+        links.splice(links.end(), chunk);
+    }
+}
+
+void Forest::load(std::string const& filename, bool clear, PinRemap* pins, LoadProgress const& progress){
+    auto path = puzzle::binary_path() + "/saves/" + filename + ".bin";
+
+    if (!std::filesystem::exists(path)){
+        return import_json(filename, clear, pins, progress);
     }
 
     if (clear){
         this->clear();
     }
 
-    json forest;
-    save_file >> forest;
-    from_json(forest, *this);
+    load_binary(path, pins);
 }
 
-
 // Roots do not have input links
 std::vector<Node*> Forest::find_roots_leaves(bool match){
     std::vector<Node*> prod;
+    find_roots_leaves(match, prod);
+    return prod;
+}
+
+void Forest::find_roots_leaves(bool match, std::vector<Node*>& prod){
+    prod.clear();
 
     for(auto& node: iter_nodes()){
         bool has_inputs = false;
@@ -195,81 +395,24 @@ std::vector<Node*> Forest::find_roots_leaves(bool match){
             prod.push_back(&node);
         }
     }
-    return prod;
 }
 
 // Roots do not have input links
 std::vector<Node*> Forest::roots(){
-    return find_roots_leaves(true);
+    return cached_roots_leaves(true);
 }
 
 // Leaves do not have output links
 std::vector<Node*> Forest::leaves(){
-    return find_roots_leaves(false);
+    return cached_roots_leaves(false);
 }
 
-void Forest::traverse(std::function<void(Node*)> fun){
-    // We should only visit a child once
-    // children can be shared
-    CircleGuard guard;
+std::vector<Node*> const& Forest::cached_roots_leaves(bool match){
+    auto i = std::size_t(match);
 
-    // Breadth-first traversal so production gets populated evenly
-    std::list<Node*> children;
-    for(auto& n: roots())
-        children.push_back(n);
-
-    while (children.size() > 0){
-        Node* node = *children.begin();
-        children.pop_front();
-
-        if (guard.count(node->ID) > 0){
-            continue;
-        }
-
-        guard[node->ID] = true;
-        fun(node);
-
-        for(auto& out_pin: node->output_pins){
-            auto link = find_link(out_pin);
-            if (!link)
-                continue;
-
-            auto next = get_next(link, node);
-            children.push_back(next);
-        }
+    if (cache_revision[i] != _revision){
+        find_roots_leaves(match, cache[i]);
+        cache_revision[i] = _revision;
     }
+    return cache[i];
 }
-
-void Forest::reverse(std::function<void(Node*)> fun){
-    // We should only visit a child once
-    // children can be shared
-    CircleGuard guard;
-
-    std::list<Node*> children;
-    for(auto& n: leaves())
-        children.push_back(n);
-
-    while (children.size() > 0){
-        Node* node = *children.begin();
-        children.pop_front();
-
-        if (guard.count(node->ID) > 0){
-            continue;
-        }
-
-        guard[node->ID] = true;
-        fun(node);
-
-        for(auto& out_pin: node->input_pins){
-            auto link = find_link(out_pin);
-            if (!link)
-                continue;
-
-            auto next = get_next(link, node);
-            children.push_back(next);
-        }
-    }
-}
-
-
-
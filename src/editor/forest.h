@@ -3,8 +3,14 @@
 
 #include "link.h"
 #include "node.h"
+#include "traversal.h"
+#include "ids.h"
+#include "components.h"
+#include "reachability.h"
+#include "spatial.h"
 
-using CircleGuard = std::unordered_map<std::size_t, bool>;
+#include <functional>
+#include <future>
 
 
 // Safe Get
@@ -37,6 +43,34 @@ Node* get_next(NodeLink* link, Node* p){
     return link->start->parent;
 }
 
+// Pin ID found in a save file to the pin it was loaded as
+// node and pin IDs are allocated separately and can overlap
+using PinRemap = IdMap<Pin const*>;
+
+// Arguments of Forest::new_node for bulk insertions
+// id and first_pin are allocated when 0, otherwise they are kept (loading)
+struct NodeSpec {
+    ImVec2        pos;
+    int           building;
+    int           recipe;
+    int           rotation  = 0;
+    std::uint32_t id        = 0;
+    std::uint32_t first_pin = 0;
+};
+
+// Records of a save, see binary_save.cpp
+struct SaveSnapshot;
+
+// Called with the fraction of the save loaded so far
+using LoadProgress = std::function<void(float)>;
+
+NLOHMANN_JSON_SERIALIZE_ENUM(SplitterRule::Kind, {
+    {SplitterRule::Any     , "any"},
+    {SplitterRule::Item    , "item"},
+    {SplitterRule::Overflow, "overflow"},
+    {SplitterRule::None    , "none"},
+})
+
 // Data structure to manage and query the graph drawn on the screen
 struct Forest{
 public:
@@ -46,26 +80,20 @@ public:
     // check if a pin is connected only once
     // if not remove it and make the new connection
     void remove_pin_link(Pin const* p){
-        auto iter = lookup.find(p->ID);
-        if (iter != lookup.end()){
-            remove_link(iter->second);
-        }
+        remove_link(lookup.get(p->ID));
     }
 
     // Add a new connection between two pins
     // checks that none of the pins are already connected to other pin
     // if so remove the previous connection
     NodeLink* new_link(Pin const* s, Pin const* e){
-        remove_pin_link(e);
-        remove_pin_link(s);
-
-        links.emplace_back(s, e);
-        auto* link = &(*links.rbegin());
-        lookup[s->ID] = link;
-        lookup[e->ID] = link;
+        return insert_link(link_ids.allocate(), s, e);
+    }
 
-        link->logic = fetch_logic(this, link);
-        return link;
+    // Recreate a link that was removed with its original ID (undo)
+    NodeLink* restore_link(std::uint32_t id, Pin const* s, Pin const* e){
+        assertf(id < link_ids.bound(), "link ID was never allocated");
+        return insert_link(id, s, e);
     }
 
     void remove_link(NodeLink* link){
@@ -74,31 +102,212 @@ public:
             return;
         }
 
+        apply_pending();
+
         debug("{}", link->start->ID);
         debug("{}", link->end->ID);
 
-        lookup.erase(link->start->ID);
-        lookup.erase(link->end->ID);
+        detach_link(link);
         links.remove(*link);
+        modified();
+    }
+
+    // Remove many links at once, the list is scanned once
+    void remove_links(std::vector<NodeLink*> const& removed){
+        apply_pending();
+        removed_links.reset();
+
+        for(auto* link: removed){
+            detach_link(link);
+            removed_links.visit(link->ID);
+        }
+
+        links.remove_if([this](NodeLink const& link){ return removed_links.visited(link.ID); });
+        modified();
     }
 
     Node* new_node(ImVec2 pos, int building, int recipe, int rotation = 0){
-        // Node(building, pos, recipe, rotation);
+        // the pins of a node get consecutive IDs
+        auto pin_count = Resources::instance().buildings[std::size_t(building)].pin_count();
 
-        Node& inserted_node = nodes.emplace_back(building, pos, recipe, rotation);
-        inserted_node.logic = fetch_logic(this, &inserted_node);
-        return &inserted_node;
+        return insert_node(
+            node_ids.allocate(),
+            pin_ids.reserve(std::uint32_t(pin_count)),
+            pos, building, recipe, rotation);
+    }
+
+    // Bulk insertion used by the loaders, must be called inside a batch
+    // nodes are constructed by up to threads threads (0 for one per core),
+    // out[i] is the node created for specs[i]. IDs are allocated in order
+    // unless all the specs have one
+    void new_nodes(std::vector<NodeSpec> const& specs, std::vector<Node*>& out, unsigned threads = 0);
+
+    // Same as above for links, ends are (start, end) pairs
+    void new_links(std::vector<std::pair<Pin const*, Pin const*>> const& ends, unsigned threads = 0);
+
+    // out[i] is the link created for ends[i]
+    void new_links(std::vector<std::pair<Pin const*, Pin const*>> const& ends, std::vector<NodeLink*>& out, unsigned threads = 0){
+        auto first = pending_links.size();
+        new_links(ends, threads);
+        out.assign(pending_links.begin() + std::ptrdiff_t(first), pending_links.end());
+    }
+
+    // Recreate a node that was removed with its original node and pin IDs (undo)
+    Node* restore_node(std::uint32_t id, std::uint32_t first_pin, ImVec2 pos, int building, int recipe, int rotation){
+        assertf(id < node_ids.bound(), "node ID was never allocated");
+        assertf(find_node(id) == nullptr, "node ID is in use");
+        return insert_node(id, first_pin, pos, building, recipe, rotation);
+    }
+
+    // Make sure the IDs below the bounds are never allocated
+    // so elements can be restored with IDs coming from somewhere else (journal)
+    void skip_ids(std::uint32_t node, std::uint32_t pin, std::uint32_t link){
+        node_ids.skip(node);
+        pin_ids.skip(pin);
+        link_ids.skip(link);
     }
 
     void remove_node(Node* node){
+        apply_pending();
+
         // remove all pins
         for(auto& side: node->pins){
             for(auto& pin: side){
                 remove_pin_link(&pin);
             }
         }
+        reach.invalidate(node);
+        spatial.remove(node->ID);
+        node_lookup.erase(node->ID);
+        splitter_rules.erase(node->ID);
+
         // remove node from the vector
         nodes.remove(*node);
+        modified();
+    }
+
+    // Remove many nodes and their links at once
+    // the lists are scanned once instead of once per node
+    void remove_nodes(std::vector<Node*> const& removed){
+        apply_pending();
+
+        removed_nodes.reset();
+        removed_links.reset();
+
+        for(auto* node: removed){
+            removed_nodes.visit(node->ID);
+
+            for(auto& pin: node->pins.all()){
+                auto* link = lookup.get(pin.ID);
+                if (link == nullptr)
+                    continue;
+
+                detach_link(link);
+                removed_links.visit(link->ID);
+            }
+
+            reach.invalidate(node);
+            spatial.remove(node->ID);
+            node_lookup.erase(node->ID);
+            splitter_rules.erase(node->ID);
+        }
+
+        links.remove_if([this](NodeLink const& link){ return removed_links.visited(link.ID); });
+        nodes.remove_if([this](Node const& node){ return removed_nodes.visited(node.ID); });
+        modified();
+    }
+
+    // Nodes have to be moved and rotated through the forest
+    // to keep the spatial index up to date
+    void move_node(Node* node, ImVec2 pos){
+        node->Pos = pos;
+        spatial.update(node->ID, bounds(node));
+    }
+
+    void rotate_node(Node* node, int rotation){
+        node->rotation = rotation;
+        spatial.update(node->ID, bounds(node));
+    }
+
+    // Move a group of nodes by delta
+    template<typename Nodes>
+    void move_nodes(Nodes const& group, ImVec2 delta){
+        for(auto* node: group){
+            move_node(node, node->Pos + delta);
+        }
+    }
+
+    // Rectangle covered by the node, pins lie on its border
+    static Box bounds(Node const* node){
+        return {node->Pos, node->Pos + node->size()};
+    }
+
+    // Call fun on every node overlapping the rectangle (canvas coordinates)
+    // nodes must not be added, removed or moved by fun
+    template<typename Fun>
+    void query(Box const& box, Fun&& fun){
+        spatial.query(box, [&](std::uint32_t id){
+            fun(find_node(id));
+        });
+    }
+
+    // Node under the point, nullptr if none
+    Node* node_at(ImVec2 pos){
+        Node* found = nullptr;
+        query({pos, pos}, [&](Node* n){ found = n; });
+        return found;
+    }
+
+    // Closest drawn pin within radius of pos, nullptr if none
+    Pin const* nearest_pin(ImVec2 pos, float radius){
+        Pin const* found = nullptr;
+        float best = radius * radius;
+
+        query({pos - ImVec2(radius, radius), pos + ImVec2(radius, radius)}, [&](Node* n){
+            for(Pin const& pin: n->pins.all()){
+                if (pin.belt_type != 'C' && pin.belt_type != 'P')
+                    continue;
+
+                auto d = pin.position() - pos;
+                auto dist = d.x * d.x + d.y * d.y;
+
+                if (dist <= best){
+                    best = dist;
+                    found = &pin;
+                }
+            }
+        });
+
+        return found;
+    }
+
+    // Edit transaction
+    // Inside a batch new_node and new_link only insert the elements
+    // logic creation, pin lookup, root/leaf recomputation and the
+    // simulation invalidation are done once in bulk on commit.
+    // Queries made during a batch do not see the pending links.
+    // Batches can be nested, only the outermost commit applies them
+    void begin_batch(){
+        batch_depth += 1;
+    }
+
+    void commit(){
+        assertf(batch_depth > 0, "commit without begin_batch");
+        batch_depth -= 1;
+
+        if (batch_depth == 0){
+            apply_pending();
+        }
+    }
+
+    bool in_batch() const {
+        return batch_depth > 0;
+    }
+
+    // Incremented every time the graph structure changes
+    // used by the simulation and caches to know when to recompute
+    std::uint64_t revision() const {
+        return _revision;
     }
 
     // checks that the Node pointer is valid
@@ -112,10 +321,78 @@ public:
     }
 
     NodeLink* find_link(Pin const* pin) const {
-        auto result = lookup.find(pin->ID);
-        if (result == lookup.end())
+        return lookup.get(pin->ID);
+    }
+
+    Node* find_node(std::uint32_t id) const {
+        return node_lookup.get(id);
+    }
+
+    // Ports connect a pin to something outside of the forest (another save)
+    // the simulation reads and writes the port book as if it was a link
+    // the book is owned by the caller
+    void set_port(Pin const* pin, ProductionBook* book){
+        ports.set(pin->ID, book);
+        modified();
+    }
+
+    ProductionBook* find_port(Pin const* pin) const {
+        return ports.get(pin->ID);
+    }
+
+    // Programmable splitters, rules are compiled into the relay routing table
+    // when they are set, no rules for an even split
+    void set_rules(Node* node, SplitterRules const& rules){
+        if (rules.empty()){
+            splitter_rules.erase(node->ID);
+        } else {
+            splitter_rules[node->ID] = rules;
+        }
+
+        if (node->logic && node->is_relay()){
+            static_cast<RelayLogic*>(node->logic.get())->compile_rules(find_rules(node));
+        }
+        modified();
+    }
+
+    SplitterRules const* find_rules(Node const* node) const {
+        auto rules = splitter_rules.find(node->ID);
+        if (rules == splitter_rules.end())
             return nullptr;
-        return result->second;
+        return &rules->second;
+    }
+
+    // Stable ID of the production line (connected component) the node belongs to
+    // components split by a removal are recomputed here, on demand
+    std::uint32_t component(Node const* node){
+        components.rebuild(
+            [this](std::uint32_t id){ return find_node(id); },
+            [this](Node* n, auto&& fun){
+                for_each_next(n, Flow::Downstream, fun);
+                for_each_next(n, Flow::Upstream, fun);
+            });
+
+        return components.label(node->ID);
+    }
+
+    // true if a feeds b, directly or not (a node feeds itself)
+    // nodes of two production lines are told apart without indexing either
+    bool feeds(Node* a, Node* b){
+        if (component(a) != component(b))
+            return false;
+        return reach.reaches(*this, a, b);
+    }
+
+    // Call fun on every node feeding node (node included)
+    template<typename Fun>
+    void for_each_upstream(Node* node, Fun&& fun){
+        reach.for_each(*this, node, Flow::Upstream, fun);
+    }
+
+    // Call fun on every node fed by node (node included)
+    template<typename Fun>
+    void for_each_downstream(Node* node, Fun&& fun){
+        reach.for_each(*this, node, Flow::Downstream, fun);
     }
 
     int node_count() const {
@@ -140,31 +417,268 @@ public:
     // Roots do not have input links
     std::vector<Node*> find_roots_leaves(bool match);
 
+    // Same as above but reuses the vector storage
+    void find_roots_leaves(bool match, std::vector<Node*>& out);
+
     // Roots do not have input links
     std::vector<Node*> roots();
 
     // Leaves do not have output links
     std::vector<Node*> leaves();
 
-    void traverse(std::function<void(Node*)> fun);
+    // Roots and leaves cached until the graph is modified
+    std::vector<Node*> const& cached_roots_leaves(bool match);
+
+    // Call fun on every node connected to node following the flow direction
+    template<typename Fun>
+    void for_each_next(Node* node, Flow flow, Fun&& fun){
+        auto pins = flow == Flow::Downstream ? node->output_pins() : node->input_pins();
+
+        for(auto* pin: pins){
+            auto link = find_link(pin);
+            if (!link)
+                continue;
+
+            fun(get_next(link, node));
+        }
+    }
+
+    // Visit every node reachable from the roots once
+    // Breadth-first traversal so production gets populated evenly
+    template<typename Visitor>
+    void traverse(Visitor&& fun){
+        walk(Flow::Downstream, Order::BreadthFirst, fun);
+    }
+
+    // Visit every node reachable from the leaves once
+    template<typename Visitor>
+    void reverse(Visitor&& fun){
+        walk(Flow::Upstream, Order::BreadthFirst, fun);
+    }
+
+    // Visit every node reachable from the roots (Downstream) or the leaves (Upstream)
+    // children can be shared, each node is only visited once
+    template<typename Visitor>
+    void walk(Flow flow, Order order, Visitor&& fun){
+        auto& w = walker;
+        auto& starts = cached_roots_leaves(flow == Flow::Downstream);
+        w.begin();
+
+        bool bfs = order == Order::BreadthFirst;
+
+        // BFS marks nodes when they are queued so the queue never
+        // holds more than one entry per node, DFS has to mark them when
+        // they are popped to preserve the depth first order
+        for(auto* node: starts){
+            if (!bfs || w.visited.visit(node->ID)){
+                w.frontier.push_back(node);
+            }
+        }
+
+        while (!w.frontier.empty()){
+            Node* node = nullptr;
+
+            if (bfs){
+                node = w.frontier.pop_front();
+            } else {
+                node = w.frontier.pop_back();
+
+                if (!w.visited.visit(node->ID)){
+                    continue;
+                }
+            }
+
+            fun(node);
+
+            for_each_next(node, flow, [&w, bfs](Node* next){
+                if (bfs ? w.visited.visit(next->ID) : !w.visited.visited(next->ID)){
+                    w.frontier.push_back(next);
+                }
+            });
+        }
+
+        w.end();
+    }
+
+    // Visit every node after all the nodes feeding it (Kahn's algorithm)
+    // Cycles are broken by visiting their first node once nothing else is ready
+    template<typename Visitor>
+    void topological(Visitor&& fun){
+        auto& w = walker;
+        w.begin();
+        w.degree.reset();
+
+        auto drain = [&](){
+            while (!w.frontier.empty()){
+                Node* node = w.frontier.pop_front();
+                fun(node);
+
+                for_each_next(node, Flow::Downstream, [&w](Node* next){
+                    if (w.visited.visited(next->ID)){
+                        return;
+                    }
+
+                    auto& degree = w.degree[next->ID];
+                    if (degree > 0){
+                        degree -= 1;
+                    }
+
+                    if (degree == 0){
+                        w.visited.visit(next->ID);
+                        w.frontier.push_back(next);
+                    }
+                });
+            }
+        };
+
+        for(auto& node: nodes){
+            std::uint32_t degree = 0;
+
+            for(auto* pin: node.input_pins()){
+                degree += find_link(pin) != nullptr;
+            }
+
+            w.degree[node.ID] = degree;
+
+            if (degree == 0){
+                w.visited.visit(node.ID);
+                w.frontier.push_back(&node);
+            }
+        }
+        drain();
+
+        for(auto& node: nodes){
+            if (w.visited.visit(node.ID)){
+                w.frontier.push_back(&node);
+                drain();
+            }
+        }
+
+        w.end();
+    }
 
-    void reverse(std::function<void(Node*)> fun);
+    // Load saves/<name>.bin, or saves/<name>.json if there is no binary save
+    // pins receives the mapping from the pin IDs of the file to the loaded pins
+    void load(std::string const& filename, bool clear=false, PinRemap* pins=nullptr, LoadProgress const& progress=nullptr);
 
-    void save(std::string const& filename, bool override=false);
+    // JSON import/export (saves/<name>.json)
+    // the import streams the file, see json_loader.cpp
+    bool export_json(std::string const& filename, bool override=false);
+    void import_json(std::string const& filename, bool clear=false, PinRemap* pins=nullptr, LoadProgress const& progress=nullptr);
 
-    void load(std::string const& filename, bool clear=false);
+    // Binary format, see binary_save.cpp
+    // compressed saves are split in blocks decompressed in parallel when loaded
+    bool save_binary(std::string const& path, bool compressed=false) const;
+
+    // Capture the records of a save, the snapshot can be written from any thread
+    // only the nodes kept, and the links between them, are captured if keep is set
+    std::shared_ptr<SaveSnapshot> snapshot(std::uint32_t generation = 0, std::function<bool(Node const*)> const& keep = nullptr) const;
+    static bool write_snapshot(SaveSnapshot const& snapshot, std::string const& path, bool compressed=false);
+    // Loaded into an empty forest the nodes keep the node and pin IDs of the save
+    bool load_binary(std::string const& path, PinRemap* pins=nullptr, unsigned threads=0);
+
+    // Generation of a binary save, 0 if it cannot be read
+    static std::uint32_t save_generation(std::string const& path);
+
+    // The binary save is compressed
+    static bool is_compressed_save(std::string const& path);
 
     void clear();
 
 private:
+    // Create the logic and pin lookup of the elements inserted during a batch
+    void apply_pending();
+
+    // Remove the link from the indices, it still needs to be removed from the list
+    void detach_link(NodeLink* link){
+        lookup.erase(link->start->ID);
+        lookup.erase(link->end->ID);
+        components.split(link->start->parent->ID, link->end->parent->ID);
+        reach.unlinked(link->start, link->end);
+    }
+
+    NodeLink* insert_link(std::uint32_t id, Pin const* s, Pin const* e){
+        if (in_batch()){
+            auto* link = &links.emplace_back(id, s, e);
+            pending_links.push_back(link);
+            return link;
+        }
+
+        remove_pin_link(e);
+        remove_pin_link(s);
+
+        links.emplace_back(id, s, e);
+        auto* link = &(*links.rbegin());
+        lookup.set(s->ID, link);
+        lookup.set(e->ID, link);
+        components.unite(s->parent->ID, e->parent->ID);
+        reach.linked(s, e);
+
+        link->logic = fetch_logic(this, link);
+        modified();
+        return link;
+    }
+
+    Node* insert_node(std::uint32_t id, std::uint32_t first_pin, ImVec2 pos, int building, int recipe, int rotation){
+        Node& inserted_node = nodes.emplace_back(id, first_pin, building, pos, recipe, rotation);
+
+        node_lookup.set(inserted_node.ID, &inserted_node);
+        components.add(inserted_node.ID);
+        spatial.insert(inserted_node.ID, bounds(&inserted_node));
+
+        if (in_batch()){
+            pending_nodes.push_back(&inserted_node);
+            return &inserted_node;
+        }
+
+        inserted_node.logic = fetch_logic(this, &inserted_node);
+        modified();
+        return &inserted_node;
+    }
+
+    void modified(){
+        _revision += 1;
+    }
+
     // We are using list because we want to use pointer as optional reference to a Node/NodeLink
     // vector would invalidate all the pointers on reallocation
     // to make prevent fragmentation a custom allocator could be provided if it becomes
     // an issue
     std::list<Node>     nodes;
     std::list<NodeLink> links;
+    // ID allocators, IDs are dense and local to the forest
+    IdAllocator node_ids;
+    IdAllocator pin_ids;
+    IdAllocator link_ids;
+
     // Pin to Link lookup
-    std::unordered_map<std::size_t, NodeLink*> lookup;
+    IdMap<NodeLink*> lookup;
+    // Node ID to Node lookup
+    IdMap<Node*>     node_lookup;
+    // Pin to external production (world boundaries)
+    IdMap<ProductionBook*> ports;
+    // Node ID to splitter rules
+    std::unordered_map<std::uint32_t, SplitterRules> splitter_rules;
+    // Production lines
+    Components       components;
+    Reachability     reach;
+    // Node rectangles on the canvas
+    SpatialGrid      spatial;
+    // Reused by the traversals so they do not allocate
+    GraphWalker<Node*> walker;
+    // Reused by remove_nodes
+    VisitedSet         removed_nodes;
+    VisitedSet         removed_links;
+
+    // Batch
+    int                    batch_depth = 0;
+    std::vector<Node*>     pending_nodes;
+    std::vector<NodeLink*> pending_links;
+    std::uint64_t          _revision = 0;
+
+    // roots (true) and leaves (false) cache
+    std::vector<Node*>     cache[2];
+    std::uint64_t          cache_revision[2] = {~0ull, ~0ull};
 };
 
 
@@ -0,0 +1,408 @@
+#include "history.h"
+#include "journal.h"
+
+// Position of the pin among the pins of its node
+static std::uint8_t slot(Pin const* pin){
+    return std::uint8_t(pin - pin->parent->pins.data());
+}
+
+std::int32_t rule_code(SplitterRules const* rules, std::size_t output){
+    if (rules == nullptr || output >= rules->size())
+        return no_rule;
+
+    auto& rule = (*rules)[output];
+    auto item = rule.kind == SplitterRule::Item ? Resources::instance().find_item(rule.item) : -1;
+    return std::int32_t(rule.kind) | ((item + 1) << 8);
+}
+
+void apply_rule(Forest& forest, Node* node, std::size_t output, std::int32_t code){
+    auto* current = forest.find_rules(node);
+    SplitterRules rules = current != nullptr ? *current : SplitterRules();
+
+    if (code == no_rule){
+        rules.resize(std::min(rules.size(), output));
+    } else {
+        if (rules.size() <= output){
+            rules.resize(output + 1);
+        }
+
+        auto& items = Resources::instance().items;
+        auto kind = code & 0xff;
+        auto item = (code >> 8) - 1;
+
+        rules[output].kind = kind <= SplitterRule::None ? SplitterRule::Kind(kind) : SplitterRule::None;
+        rules[output].item = item >= 0 && std::size_t(item) < items.size() ? items[std::size_t(item)] : std::string();
+    }
+
+    forest.set_rules(node, rules);
+}
+
+void History::begin_step(){
+    depth += 1;
+}
+
+void History::end_step(){
+    assertf(depth > 0, "end_step without begin_step");
+    depth -= 1;
+
+    if (depth == 0){
+        open = false;
+    }
+}
+
+void History::clear(){
+    edits.clear();
+    steps.clear();
+    redo_edits.clear();
+    redo_steps.clear();
+    open = false;
+}
+
+void History::record(Edit const& edit){
+    if (journal != nullptr){
+        journal->append(edit, true);
+    }
+
+    redo_edits.clear();
+    redo_steps.clear();
+
+    // outside of a step every edit is its own step
+    if (depth == 0 || !open){
+        steps.push_back(0);
+        open = depth > 0;
+    }
+
+    edits.push_back(edit);
+    steps.back() += 1;
+    trim();
+}
+
+void History::record(std::vector<Edit> const& batch){
+    if (batch.empty())
+        return;
+
+    if (journal != nullptr){
+        for(auto& edit: batch){
+            journal->append(edit, true);
+        }
+    }
+
+    redo_edits.clear();
+    redo_steps.clear();
+
+    // outside of a step the batch is its own step
+    if (depth == 0 || !open){
+        steps.push_back(0);
+        open = depth > 0;
+    }
+
+    edits.insert(edits.end(), batch.begin(), batch.end());
+    steps.back() += std::uint32_t(batch.size());
+    trim();
+}
+
+void History::trim(){
+    // drop the oldest steps, the current one is kept even if it is too large
+    while (edits.size() > max_edits && steps.size() > 1){
+        for(std::uint32_t i = 0; i < steps.front(); ++i){
+            edits.pop_front();
+        }
+        steps.pop_front();
+    }
+}
+
+Edit History::node_edit(EditKind kind, Node* node){
+    Edit edit{kind};
+    edit.id       = node->ID;
+    edit.start    = node->pins.size() > 0 ? node->pins.all()[0].ID : 0;
+    edit.building = node->building;
+    edit.from     = node->recipe_idx;
+    edit.to       = node->rotation;
+    edit.from_pos = node->Pos;
+    return edit;
+}
+
+void History::record_node(EditKind kind, Node* node){
+    record(node_edit(kind, node));
+}
+
+void History::record_rules(Node* node, SplitterRules const& rules){
+    auto* current = forest.find_rules(node);
+    auto count = std::max(rules.size(), current != nullptr ? current->size() : 0);
+
+    for(auto i = 0u; i < count && i < NodePins::capacity; ++i){
+        Edit edit{EditKind::Rule};
+        edit.id         = node->ID;
+        edit.start_slot = std::uint8_t(i);
+        edit.from       = rule_code(current, i);
+        edit.to         = rule_code(&rules, i);
+
+        if (edit.from != edit.to){
+            record(edit);
+        }
+    }
+}
+
+Edit History::link_edit(EditKind kind, NodeLink* link){
+    Edit edit{kind};
+    edit.id         = link->ID;
+    edit.start      = link->start->parent->ID;
+    edit.start_slot = slot(link->start);
+    edit.end        = link->end->parent->ID;
+    edit.end_slot   = slot(link->end);
+    return edit;
+}
+
+void History::record_link(EditKind kind, NodeLink* link){
+    record(link_edit(kind, link));
+}
+
+Node* History::new_node(ImVec2 pos, int building, int recipe, int rotation){
+    auto* node = forest.new_node(pos, building, recipe, rotation);
+    record_node(EditKind::AddNode, node);
+    return node;
+}
+
+void History::new_nodes(std::vector<NodeSpec> const& specs, std::vector<Node*>& out){
+    forest.new_nodes(specs, out);
+
+    bulk.clear();
+    bulk.reserve(out.size());
+    for(auto* node: out){
+        bulk.push_back(node_edit(EditKind::AddNode, node));
+    }
+    record(bulk);
+}
+
+void History::new_links(std::vector<std::pair<Pin const*, Pin const*>> const& ends){
+    // the pins are new, there are no previous links to replace
+    forest.new_links(ends, bulk_links);
+
+    bulk.clear();
+    bulk.reserve(bulk_links.size());
+    for(auto* link: bulk_links){
+        bulk.push_back(link_edit(EditKind::AddLink, link));
+    }
+    record(bulk);
+}
+
+void History::remove_node(Node* node){
+    begin_step();
+
+    for(auto& pin: node->pins.all()){
+        auto* link = forest.find_link(&pin);
+        if (link != nullptr){
+            record_link(EditKind::RemoveLink, link);
+        }
+    }
+
+    // undone after the node is restored
+    record_rules(node, {});
+    record_node(EditKind::RemoveNode, node);
+    forest.remove_node(node);
+    end_step();
+}
+
+void History::remove_nodes(std::vector<Node*> const& nodes){
+    begin_step();
+
+    // links between two removed nodes are only recorded once
+    recorded.reset();
+
+    for(auto* node: nodes){
+        for(auto& pin: node->pins.all()){
+            auto* link = forest.find_link(&pin);
+            if (link != nullptr && recorded.visit(link->ID)){
+                record_link(EditKind::RemoveLink, link);
+            }
+        }
+    }
+
+    for(auto* node: nodes){
+        record_rules(node, {});
+        record_node(EditKind::RemoveNode, node);
+    }
+
+    forest.remove_nodes(nodes);
+    end_step();
+}
+
+NodeLink* History::new_link(Pin const* s, Pin const* e){
+    begin_step();
+
+    // pins can only be connected once, the previous links are replaced
+    auto* old_end   = forest.find_link(e);
+    auto* old_start = forest.find_link(s);
+
+    if (old_end != nullptr){
+        record_link(EditKind::RemoveLink, old_end);
+    }
+    if (old_start != nullptr && old_start != old_end){
+        record_link(EditKind::RemoveLink, old_start);
+    }
+
+    auto* link = forest.new_link(s, e);
+    record_link(EditKind::AddLink, link);
+
+    end_step();
+    return link;
+}
+
+void History::remove_link(NodeLink* link){
+    if (link == nullptr)
+        return;
+
+    record_link(EditKind::RemoveLink, link);
+    forest.remove_link(link);
+}
+
+void History::rotate_node(Node* node, int rotation){
+    Edit edit{EditKind::Rotate};
+    edit.id   = node->ID;
+    edit.from = node->rotation;
+    edit.to   = rotation;
+    record(edit);
+
+    forest.rotate_node(node, rotation);
+}
+
+void History::set_recipe(Node* node, int recipe){
+    Edit edit{EditKind::Recipe};
+    edit.id   = node->ID;
+    edit.from = node->recipe_idx;
+    edit.to   = recipe;
+    record(edit);
+
+    node->recipe_idx = recipe;
+    node->logic->reset();
+}
+
+void History::set_rules(Node* node, SplitterRules const& rules){
+    begin_step();
+    record_rules(node, rules);
+    end_step();
+
+    forest.set_rules(node, rules);
+}
+
+void History::moved(Node* node, ImVec2 from){
+    if (from.x == node->Pos.x && from.y == node->Pos.y)
+        return;
+
+    Edit edit{EditKind::Move};
+    edit.id       = node->ID;
+    edit.from_pos = from;
+    edit.to_pos   = node->Pos;
+    record(edit);
+}
+
+bool History::undo(){
+    if (steps.empty())
+        return false;
+
+    auto n = steps.back();
+    steps.pop_back();
+
+    // last edit first, they end up reversed in the redo journal
+    for(std::uint32_t i = 0; i < n; ++i){
+        apply(edits.back(), false);
+        redo_edits.push_back(edits.back());
+        edits.pop_back();
+    }
+    flush();
+
+    redo_steps.push_back(n);
+    open = false;
+    return true;
+}
+
+bool History::redo(){
+    if (redo_steps.empty())
+        return false;
+
+    auto n = redo_steps.back();
+    redo_steps.pop_back();
+
+    for(std::uint32_t i = 0; i < n; ++i){
+        apply(redo_edits.back(), true);
+        edits.push_back(redo_edits.back());
+        redo_edits.pop_back();
+    }
+    flush();
+
+    steps.push_back(n);
+    open = false;
+    return true;
+}
+
+void History::apply(Edit const& edit, bool forward){
+    if (journal != nullptr){
+        journal->append(edit, forward);
+    }
+
+    switch (edit.kind){
+    case EditKind::AddNode:
+        return forward ? add_node(edit) : delete_node(edit);
+
+    case EditKind::RemoveNode:
+        return forward ? delete_node(edit) : add_node(edit);
+
+    case EditKind::AddLink:
+        return forward ? add_link(edit) : delete_link(edit);
+
+    case EditKind::RemoveLink:
+        return forward ? delete_link(edit) : add_link(edit);
+
+    case EditKind::Move:
+        return forest.move_node(forest.find_node(edit.id), forward ? edit.to_pos : edit.from_pos);
+
+    case EditKind::Rotate:
+        return forest.rotate_node(forest.find_node(edit.id), forward ? edit.to : edit.from);
+
+    case EditKind::Recipe: {
+        auto* node = forest.find_node(edit.id);
+        node->recipe_idx = forward ? edit.to : edit.from;
+        node->logic->reset();
+        return;
+    }
+
+    case EditKind::Rule:
+        return apply_rule(forest, forest.find_node(edit.id), edit.start_slot, forward ? edit.to : edit.from);
+    }
+}
+
+void History::add_node(Edit const& edit){
+    flush();
+    forest.restore_node(edit.id, edit.start, edit.from_pos, edit.building, edit.from, edit.to);
+}
+
+// Removals are deferred until the end of the step, or until something is added,
+// so they are done in bulk. The other edits can still refer to the removed
+// elements in the meantime
+void History::delete_node(Edit const& edit){
+    deleted.push_back(forest.find_node(edit.id));
+}
+
+void History::flush(){
+    if (deleted_links.size() > 0){
+        forest.remove_links(deleted_links);
+        deleted_links.clear();
+    }
+
+    if (deleted.size() > 0){
+        forest.remove_nodes(deleted);
+        deleted.clear();
+    }
+}
+
+void History::add_link(Edit const& edit){
+    flush();
+    auto* s = &forest.find_node(edit.start)->pins.all()[edit.start_slot];
+    auto* e = &forest.find_node(edit.end)->pins.all()[edit.end_slot];
+    forest.restore_link(edit.id, s, e);
+}
+
+void History::delete_link(Edit const& edit){
+    auto* s = &forest.find_node(edit.start)->pins.all()[edit.start_slot];
+    deleted_links.push_back(forest.find_link(s));
+}
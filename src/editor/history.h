@@ -0,0 +1,150 @@
+#ifndef PUZZLE_EDITOR_HISTORY_HEADER
+#define PUZZLE_EDITOR_HISTORY_HEADER
+
+#include "forest.h"
+
+#include <deque>
+#include <vector>
+
+struct Journal;
+
+// Kind of edit recorded by the History
+enum class EditKind: std::uint8_t {
+    AddNode,
+    RemoveNode,
+    AddLink,
+    RemoveLink,
+    Move,
+    Rotate,
+    Recipe,
+    Rule
+};
+
+// A single edit, with enough information to apply and revert it
+// Elements are referred to by ID (pins by node ID and slot) because
+// reverting a removal creates a new Node/NodeLink with the same IDs
+struct Edit {
+    EditKind      kind;
+    std::uint8_t  start_slot = 0;   // links: pin slot of the start/end nodes
+    std::uint8_t  end_slot   = 0;
+    std::uint32_t id         = 0;   // node or link ID
+    std::uint32_t start      = 0;   // links: start/end node IDs
+    std::uint32_t end        = 0;   // nodes: first pin ID in start
+    std::int32_t  building   = -1;
+    std::int32_t  from       = 0;   // recipe, rotation or rule code before/after the edit
+    std::int32_t  to         = 0;   // nodes: recipe in from, rotation in to
+                                    // rules: output in start_slot
+    ImVec2        from_pos;         // position before/after the edit
+    ImVec2        to_pos;           // nodes: position in from_pos
+};
+
+// Splitter rules are recorded one output at a time, the rule of an output
+// is packed in an int32: kind in the low byte, item ID + 1 above it.
+// no_rule is past the last rule of the node
+constexpr std::int32_t no_rule = -1;
+
+std::int32_t rule_code(SplitterRules const* rules, std::size_t output);
+
+// Set the rule of an output of the node from its code
+void apply_rule(Forest& forest, Node* node, std::size_t output, std::int32_t code);
+
+// Journal of the edits made to a forest
+// Undo and redo replay the inverse (or the edit itself) so they cost
+// time proportional to the edit, not to the size of the forest.
+// Edits are grouped in steps, one step is undone at a time.
+// The journal keeps at most max_edits edits, oldest steps are dropped first
+//
+// Edits have to go through the History to be recorded
+// they are also appended to the autosave journal if there is one
+struct History {
+    History(Forest& forest, std::size_t max_edits = 1 << 16):
+        forest(forest), max_edits(max_edits)
+    {}
+
+    // Group the following edits into a single step, can be nested
+    void begin_step();
+
+    void end_step();
+
+    Node*     new_node   (ImVec2 pos, int building, int recipe, int rotation = 0);
+    void      remove_node(Node* node);
+    void      remove_nodes(std::vector<Node*> const& nodes);
+    NodeLink* new_link   (Pin const* s, Pin const* e);
+    void      remove_link(NodeLink* link);
+    void      rotate_node(Node* node, int rotation);
+    void      set_recipe (Node* node, int recipe);
+    void      set_rules  (Node* node, SplitterRules const& rules);
+
+    // Bulk insertion (paste), must be called inside a forest batch
+    // the edits are appended to the current step at once
+    void new_nodes(std::vector<NodeSpec> const& specs, std::vector<Node*>& out);
+    void new_links(std::vector<std::pair<Pin const*, Pin const*>> const& ends);
+
+    // Nodes are dragged interactively, record the move once it is done
+    void      moved      (Node* node, ImVec2 from);
+
+    // Returns false if there was nothing to undo/redo
+    // Node and NodeLink pointers might be invalidated
+    bool undo();
+    bool redo();
+
+    bool can_undo() const { return steps.size() > 0; }
+    bool can_redo() const { return redo_steps.size() > 0; }
+
+    Forest& graph(){
+        return forest;
+    }
+
+    // Journal receiving the edits as they are made, undone or redone
+    void set_journal(Journal* j){
+        journal = j;
+    }
+
+    // Forget everything (the forest was loaded or cleared)
+    void clear();
+
+private:
+    void record(Edit const& edit);
+    void record(std::vector<Edit> const& batch);
+    void trim();
+    void record_node(EditKind kind, Node* node);
+    void record_link(EditKind kind, NodeLink* link);
+
+    static Edit node_edit(EditKind kind, Node* node);
+    static Edit link_edit(EditKind kind, NodeLink* link);
+
+    // Record the rule edits turning the rules of the node into rules
+    void record_rules(Node* node, SplitterRules const& rules);
+
+    // Apply the edit forward or backward
+    void apply(Edit const& edit, bool forward);
+
+    void add_node   (Edit const& edit);
+    void add_link   (Edit const& edit);
+    void delete_node(Edit const& edit);
+    void delete_link(Edit const& edit);
+    void flush();
+
+    Forest&     forest;
+    Journal*    journal = nullptr;
+    std::size_t max_edits;
+    int         depth = 0;
+    bool        open  = false;  // the current step has edits
+
+    // Elements removed by the step being undone/redone, removed in bulk
+    std::vector<Node*>     deleted;
+    std::vector<NodeLink*> deleted_links;
+    VisitedSet         recorded;
+    std::vector<Edit>      bulk;
+    std::vector<NodeLink*> bulk_links;
+
+    // Undo journal, steps holds the number of edits of each step
+    std::deque<Edit>          edits;
+    std::deque<std::uint32_t> steps;
+
+    // Redo journal, cleared when a new edit is recorded
+    std::vector<Edit>          redo_edits;
+    std::vector<std::uint32_t> redo_steps;
+};
+
+#endif
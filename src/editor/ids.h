@@ -0,0 +1,85 @@
+#ifndef PUZZLE_EDITOR_IDS_HEADER
+#define PUZZLE_EDITOR_IDS_HEADER
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Thread-safe allocator of dense IDs
+// Each forest owns one allocator per kind of element (node, pin, link)
+// so IDs start from 1 for every forest and can be used to index arrays.
+// 0 is never allocated and can be used as an invalid ID
+struct IdAllocator {
+    IdAllocator() = default;
+
+    IdAllocator(IdAllocator const&) = delete;
+
+    std::uint32_t allocate(){
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Reserve a block of n consecutive IDs, returns the first one
+    std::uint32_t reserve(std::uint32_t n){
+        return next.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Upper bound (exclusive) of the IDs handed out so far
+    std::uint32_t bound() const {
+        return next.load(std::memory_order_relaxed);
+    }
+
+    // Never hand out the IDs below bound, used to recreate elements with known IDs
+    void skip(std::uint32_t bound){
+        auto current = next.load(std::memory_order_relaxed);
+        while (current < bound && !next.compare_exchange_weak(current, bound, std::memory_order_relaxed)){}
+    }
+
+    // Only valid when none of the previously allocated IDs are in use anymore
+    void reset(){
+        next.store(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint32_t> next{1};
+};
+
+
+// Map from dense IDs to values, missing entries are default initialized
+template<typename T>
+struct IdMap {
+    T get(std::uint32_t id) const {
+        if (id < values.size())
+            return values[id];
+        return T();
+    }
+
+    void set(std::uint32_t id, T const& v){
+        if (id >= values.size()){
+            values.resize(std::max<std::size_t>(id + 1, values.size() * 2));
+        }
+        values[id] = v;
+    }
+
+    void erase(std::uint32_t id){
+        if (id < values.size()){
+            values[id] = T();
+        }
+    }
+
+    // Make sure ids below bound can be set without reallocation
+    void reserve(std::uint32_t bound){
+        if (bound > values.size()){
+            values.resize(bound);
+        }
+    }
+
+    void clear(){
+        values.clear();
+    }
+
+private:
+    std::vector<T> values;
+};
+
+#endif
@@ -0,0 +1,396 @@
+#include "journal.h"
+
+#include <limits>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Journal file, native endianness
+//
+//  JournalHeader
+//  JournalRecord   records [...]   (until the end of the file)
+//
+// Records are appended as the edits are made, a record torn by a crash
+// fails its checksum and ends the replay
+namespace {
+
+constexpr char          journal_magic[4] = {'P', 'Z', 'L', 'J'};
+constexpr std::uint32_t journal_version  = 2;
+
+struct JournalHeader {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint32_t generation;   // generation of the save the edits apply to
+    std::uint32_t reserved;
+    std::uint64_t catalog;      // Resources::checksum the edits were made with
+};
+
+// IDs of the journal are restored, the next ones are skipped
+bool valid_id(std::uint32_t id, std::uint32_t count = 1){
+    return id != 0 && id <= std::numeric_limits<std::uint32_t>::max() - count;
+}
+
+// FNV-1a
+std::uint32_t checksum(void const* data, std::size_t size){
+    auto* bytes = static_cast<unsigned char const*>(data);
+    std::uint32_t hash = 2166136261u;
+
+    for(std::size_t i = 0; i < size; ++i){
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool sync(std::FILE* file){
+    if (std::fflush(file) != 0)
+        return false;
+#ifdef __linux__
+    return ::fdatasync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+}
+
+Journal::Journal(Forest& forest, std::string save_path, std::size_t compact_after):
+    forest(forest),
+    save_path(std::move(save_path)),
+    journal_path(std::filesystem::path(this->save_path).replace_extension(".journal").string()),
+    compact_after(compact_after),
+    compress(Forest::is_compressed_save(this->save_path))
+{}
+
+Journal::~Journal(){
+    if (pending.size() > 0 && file != nullptr){
+        write(pending);
+    }
+    pending.clear();
+    finish(true);
+
+    if (file != nullptr){
+        std::fclose(file);
+    }
+}
+
+void Journal::append(Edit const& edit, bool forward){
+    JournalRecord record;
+    std::memset(static_cast<void*>(&record), 0, sizeof(record));
+    std::memcpy(&record.edit, &edit, sizeof(edit));
+    record.forward = forward ? 1 : 0;
+    record.check   = checksum(&record, offsetof(JournalRecord, check));
+
+    pending.push_back(record);
+
+    if (compaction.valid()){
+        since_snapshot.push_back(record);
+    }
+}
+
+bool Journal::write(std::vector<JournalRecord> const& records){
+    if (file == nullptr)
+        return false;
+
+    if (std::fwrite(records.data(), sizeof(JournalRecord), records.size(), file) != records.size() || !sync(file)){
+        warn("Could not write {}: {}", journal_path, std::strerror(errno));
+        return false;
+    }
+
+    entries += records.size();
+    return true;
+}
+
+bool Journal::autosave(bool allow_compaction){
+    bool written = true;
+
+    // without a journal file the edits are only covered by the compaction
+    if (pending.size() > 0){
+        written = file == nullptr || write(pending);
+        pending.clear();
+    }
+
+    finish(false);
+
+    if (allow_compaction && !compaction.valid() && entries >= compact_after){
+        compact();
+    }
+    return written;
+}
+
+std::shared_future<bool> Journal::compact(){
+    if (compaction.valid())
+        return compaction;
+
+    // the current journal stays valid until the new save is written
+    if (pending.size() > 0){
+        write(pending);
+        pending.clear();
+    }
+
+    auto records = forest.snapshot(generation + 1);
+    auto path = save_path;
+    auto compressed = compress;
+
+    compaction = std::async(std::launch::async, [records, path, compressed](){
+        return Forest::write_snapshot(*records, path, compressed);
+    }).share();
+
+    return compaction;
+}
+
+void Journal::finish(bool wait){
+    if (!compaction.valid())
+        return;
+
+    if (!wait && compaction.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return;
+
+    if (compaction.get()){
+        generation += 1;
+        restart(since_snapshot);
+    } else {
+        warn("Journal {} could not be compacted", journal_path);
+    }
+
+    since_snapshot.clear();
+    compaction = std::shared_future<bool>();
+}
+
+bool Journal::restart(std::vector<JournalRecord> const& records){
+    if (file != nullptr){
+        std::fclose(file);
+        file = nullptr;
+    }
+    entries = 0;
+
+    // written aside then renamed, a crash leaves one of the two journals
+    auto tmp = journal_path + ".tmp";
+    file = std::fopen(tmp.c_str(), "wb");
+
+    if (file == nullptr){
+        warn("File could not be created:{} ", tmp);
+        return false;
+    }
+
+    JournalHeader header = {};
+    std::memcpy(header.magic, journal_magic, sizeof(journal_magic));
+    header.version    = journal_version;
+    header.generation = generation;
+    header.catalog    = Resources::instance().checksum;
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 && (records.empty() || write(records)) && sync(file);
+    std::fclose(file);
+    file = nullptr;
+
+    if (!written || std::rename(tmp.c_str(), journal_path.c_str()) != 0){
+        warn("Could not write {}: {}", journal_path, std::strerror(errno));
+        std::remove(tmp.c_str());
+        entries = 0;
+        return false;
+    }
+
+    file = std::fopen(journal_path.c_str(), "ab");
+    return file != nullptr;
+}
+
+std::size_t Journal::recover(){
+    pending.clear();
+    finish(true);
+
+    forest.clear();
+
+    if (!forest.load_binary(save_path)){
+        return 0;
+    }
+    generation = Forest::save_generation(save_path);
+
+    auto records = read();
+    std::size_t skipped = 0;
+
+    for(auto& record: records){
+        skipped += replay(record) ? 0 : 1;
+    }
+    flush();
+
+    if (skipped > 0){
+        warn("{} edits of {} could not be replayed", skipped, journal_path);
+    }
+
+    // the torn record at the end, if any, is dropped
+    restart(records);
+    return records.size();
+}
+
+std::size_t Journal::recoverable() const {
+    return read().size();
+}
+
+void Journal::attach(){
+    pending.clear();
+    finish(true);
+
+    generation = Forest::save_generation(save_path);
+    restart({});
+}
+
+std::vector<JournalRecord> Journal::read() const {
+    std::vector<JournalRecord> records;
+    std::FILE* journal = std::fopen(journal_path.c_str(), "rb");
+
+    if (journal == nullptr)
+        return records;
+
+    JournalHeader header = {};
+    bool matches = std::fread(&header, sizeof(header), 1, journal) == 1
+        && std::memcmp(header.magic, journal_magic, sizeof(journal_magic)) == 0
+        && header.version == journal_version
+        && header.generation == Forest::save_generation(save_path);
+
+    if (matches && header.catalog != Resources::instance().checksum){
+        warn("{} was written with other resources, it is ignored", journal_path);
+        matches = false;
+    }
+
+    // up to the first invalid record
+    JournalRecord record;
+    while (matches && std::fread(&record, sizeof(record), 1, journal) == 1){
+        if (record.check != checksum(&record, offsetof(JournalRecord, check)))
+            break;
+        records.push_back(record);
+    }
+
+    std::fclose(journal);
+    return records;
+}
+
+bool Journal::replay(JournalRecord const& record){
+    auto& edit = record.edit;
+    bool forward = record.forward != 0;
+    auto& buildings = Resources::instance().buildings;
+
+    auto pin = [this](std::uint32_t id, std::uint8_t slot) -> Pin const* {
+        auto* node = forest.find_node(id);
+        if (node == nullptr || slot >= node->pins.size())
+            return nullptr;
+        return &node->pins.all()[slot];
+    };
+
+    switch (edit.kind){
+    case EditKind::AddNode:
+    case EditKind::RemoveNode: {
+        if (forward == (edit.kind == EditKind::AddNode)){
+            flush();
+
+            if (edit.building < 0 || std::size_t(edit.building) >= buildings.size()){
+                warn("Journaled node {} has an unknown building {}", edit.id, edit.building);
+                return false;
+            }
+
+            auto& building = buildings[std::size_t(edit.building)];
+            auto pins = std::uint32_t(building.pin_count());
+
+            if (edit.from < -1 || edit.from >= int(building.recipes.size())){
+                warn("Journaled node {} has an unknown recipe {}", edit.id, edit.from);
+                return false;
+            }
+
+            if (!valid_id(edit.id) || !valid_id(edit.start, pins) || forest.find_node(edit.id) != nullptr){
+                warn("Journaled node {} conflicts with the save", edit.id);
+                return false;
+            }
+
+            forest.skip_ids(edit.id + 1, edit.start + pins, 0);
+            forest.restore_node(edit.id, edit.start, edit.from_pos, edit.building, edit.from, edit.to);
+        } else if (auto* node = forest.find_node(edit.id)){
+            deleted.push_back(node);
+        }
+        return true;
+    }
+
+    case EditKind::AddLink:
+    case EditKind::RemoveLink: {
+        auto* s = pin(edit.start, edit.start_slot);
+        auto* e = pin(edit.end, edit.end_slot);
+
+        if (s == nullptr || e == nullptr){
+            warn("Journaled link {} is not connected", edit.id);
+            return false;
+        }
+
+        if (forward == (edit.kind == EditKind::AddLink)){
+            if (!valid_id(edit.id)){
+                warn("Journaled link {} has an invalid ID", edit.id);
+                return false;
+            }
+
+            flush();
+            forest.skip_ids(0, 0, edit.id + 1);
+            forest.restore_link(edit.id, s, e);
+        } else if (auto* link = forest.find_link(s)){
+            deleted_links.push_back(link);
+        }
+        return true;
+    }
+
+    default:
+        break;
+    }
+
+    auto* node = forest.find_node(edit.id);
+    if (node == nullptr){
+        warn("Journaled node {} does not exist", edit.id);
+        return false;
+    }
+
+    switch (edit.kind){
+    case EditKind::Move:
+        forest.move_node(node, forward ? edit.to_pos : edit.from_pos);
+        return true;
+
+    case EditKind::Rotate:
+        forest.rotate_node(node, forward ? edit.to : edit.from);
+        return true;
+
+    case EditKind::Recipe: {
+        auto recipe = forward ? edit.to : edit.from;
+        if (recipe < -1 || recipe >= int(node->descriptor->recipes.size())){
+            warn("Journaled node {} has an unknown recipe {}", edit.id, recipe);
+            return false;
+        }
+
+        node->recipe_idx = recipe;
+        node->logic->reset();
+        return true;
+    }
+
+    case EditKind::Rule:
+        if (edit.start_slot >= node->output_pins().size()){
+            warn("Journaled node {} has no output {}", edit.id, edit.start_slot);
+            return false;
+        }
+
+        apply_rule(forest, node, edit.start_slot, forward ? edit.to : edit.from);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+void Journal::flush(){
+    if (deleted_links.size() > 0){
+        forest.remove_links(deleted_links);
+        deleted_links.clear();
+    }
+
+    if (deleted.size() > 0){
+        forest.remove_nodes(deleted);
+        deleted.clear();
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef PUZZLE_EDITOR_JOURNAL_HEADER
+#define PUZZLE_EDITOR_JOURNAL_HEADER
+
+#include "history.h"
+
+#include <cstdio>
+#include <future>
+
+// One journaled edit, see journal.cpp for the file layout
+struct JournalRecord {
+    Edit          edit;
+    std::uint8_t  forward;      // the edit was applied (1) or reverted (0)
+    std::uint8_t  reserved[3];
+    std::uint32_t check;        // checksum of the bytes above
+};
+
+// Autosave journal of a binary save (saves/<name>.bin)
+// Every edit recorded, undone or redone by the History is appended to
+// saves/<name>.journal, autosave only writes the edits made since the last one
+// so its I/O is proportional to the edit rate, not to the size of the forest.
+// The save itself is rewritten when the journal is compacted, in the background.
+//
+// A journal belongs to a generation of the save, bumped by each compaction.
+// After a crash, recover() loads the save and replays the journal on top of it
+// when their generations match; a journal older than its save was compacted
+// already and is ignored. Loading keeps the IDs of the save and the replay
+// recreates the elements with their journaled IDs, the recovered forest has
+// the IDs of the session that crashed and the journal carries on.
+// Buildings, recipes and items are journaled by index, the journal is only valid
+// with the configuration it was written with: the header holds the checksum
+// of the catalog and a journal written with another catalog is not replayed.
+// Records that do not apply to the recovered forest are skipped with a warning
+struct Journal {
+    Journal(Forest& forest, std::string save_path, std::size_t compact_after = 1 << 16);
+
+    // Write the pending edits and wait for the compaction
+    ~Journal();
+
+    Journal(Journal const&) = delete;
+
+    // Called by the History
+    void append(Edit const& edit, bool forward);
+
+    // Write and sync the edits appended since the last call,
+    // compact the journal once it holds compact_after edits
+    // (held back while the forest is partially loaded).
+    // Returns false if the edits could not be written
+    bool autosave(bool allow_compaction = true);
+
+    // Rewrite the save from the forest and start an empty journal
+    // the future is true once the save is on disk
+    std::shared_future<bool> compact();
+
+    // Load the save and replay the journal left by the previous session
+    // returns the number of edits replayed
+    std::size_t recover();
+
+    // Number of edits recover() would replay
+    std::size_t recoverable() const;
+
+    // Start an empty journal for the save as it is on disk,
+    // the forest holds the save or is loading it (TiledSave)
+    void attach();
+
+    // Write compressed saves from the next compaction,
+    // by default the save keeps the format it has on disk
+    void set_compressed(bool value){
+        compress = value;
+    }
+
+    bool compressed() const {
+        return compress;
+    }
+
+    std::string const& path() const {
+        return save_path;
+    }
+
+    // Edits in the journal file
+    std::size_t size() const {
+        return entries;
+    }
+
+private:
+    bool write(std::vector<JournalRecord> const& records);
+
+    // Records of the journal file if it belongs to the save on disk
+    std::vector<JournalRecord> read() const;
+
+    // Start a new journal file for the current generation holding records
+    bool restart(std::vector<JournalRecord> const& records);
+
+    // Switch to the compacted save once it is written
+    void finish(bool wait);
+
+    // Apply a journaled edit, returns false if it was skipped
+    bool replay(JournalRecord const& record);
+    void flush();
+
+    Forest&     forest;
+    std::string save_path;
+    std::string journal_path;
+    std::size_t compact_after;
+    std::FILE*  file = nullptr;
+    bool        compress = false;
+
+    std::uint32_t generation = 0;
+    std::size_t   entries    = 0;
+
+    // Edits not written yet
+    std::vector<JournalRecord> pending;
+
+    // Background compaction, the edits made once it started
+    // are moved to the next journal
+    std::shared_future<bool>   compaction;
+    std::vector<JournalRecord> since_snapshot;
+
+    // Removals done by the replay, done in bulk like the History does
+    std::vector<Node*>     deleted;
+    std::vector<NodeLink*> deleted_links;
+};
+
+#endif
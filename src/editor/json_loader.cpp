@@ -0,0 +1,300 @@
+#include "forest.h"
+
+#include <filesystem>
+
+// Streaming JSON save loader
+// Nodes are created as soon as their object is read, only one node is kept
+// in memory at a time instead of the whole document.
+// export_json writes "nodes" before "links" and the links are created as they
+// are read; older saves have "links" first (nlohmann writes the keys in
+// alphabetical order), their links are kept as pairs of pin IDs until the nodes are loaded
+namespace {
+
+struct ForestLoader: public nlohmann::json_sax<json> {
+    enum Frame {
+        Root,
+        Nodes,
+        Links,
+        NodeObject,
+        LinkObject,
+        Position,
+        Sides,
+        Side,
+        PinObject,
+        Rules,
+        RuleObject,
+        Skip
+    };
+
+    Forest&             forest;
+    PinRemap&           remap;
+    std::istream&       input;
+    float               input_size;
+    LoadProgress const& progress;
+
+    std::vector<Frame>  frames;
+    std::string         current_key;
+
+    // node being read
+    std::string         building;
+    std::string         recipe;
+    ImVec2              pos;
+    int                 coordinate = 0;
+    int                 rotation   = 0;
+    std::vector<std::uint32_t> sides[4];
+    int                 side = 0;
+    SplitterRules       rules;
+
+    // link being read
+    std::uint32_t       start = 0;
+    std::uint32_t       end   = 0;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pending_links;
+    bool                nodes_loaded = false;
+
+    std::size_t         records = 0;
+    Resources&          rsc = Resources::instance();
+    std::unordered_map<std::string, int> buildings;
+
+    ForestLoader(Forest& f, PinRemap& r, std::istream& in, float size, LoadProgress const& p):
+        forest(f), remap(r), input(in), input_size(size), progress(p)
+    {}
+
+    Frame top() const {
+        return frames.empty() ? Skip : frames.back();
+    }
+
+    // Frame of the object or array starting under the current frame
+    Frame child(bool object) const {
+        if (frames.empty())
+            return object ? Root : Skip;
+
+        switch (top()){
+        case Root:
+            if (current_key == "nodes") return Nodes;
+            if (current_key == "links") return Links;
+            return Skip;
+        case Nodes:
+            return object ? NodeObject : Skip;
+        case Links:
+            return object ? LinkObject : Skip;
+        case NodeObject:
+            if (current_key == "pos")   return Position;
+            if (current_key == "sides") return Sides;
+            if (current_key == "rules") return Rules;
+            return Skip;
+        case Sides:
+            return object ? Skip : Side;
+        case Side:
+            return object ? PinObject : Skip;
+        case Rules:
+            return object ? RuleObject : Skip;
+        default:
+            return Skip;
+        }
+    }
+
+    void report(){
+        records += 1;
+
+        if (progress && records % 4096 == 0){
+            progress(float(input.tellg()) / input_size);
+        }
+    }
+
+    void number(double v){
+        switch (top()){
+        case Position:
+            (coordinate == 0 ? pos.x : pos.y) = float(v);
+            coordinate += 1;
+            return;
+        case NodeObject:
+            if (current_key == "rotation")
+                rotation = int(v);
+            return;
+        case PinObject:
+            if (current_key == "id" && side < 4)
+                sides[side].push_back(std::uint32_t(v));
+            return;
+        case LinkObject:
+            if (current_key == "start") start = std::uint32_t(v);
+            if (current_key == "end")   end   = std::uint32_t(v);
+            return;
+        default:
+            return;
+        }
+    }
+
+    void begin_node(){
+        building.clear();
+        recipe.clear();
+        pos = ImVec2(0, 0);
+        coordinate = 0;
+        rotation = 0;
+        side = 0;
+        rules.clear();
+
+        for(auto& pins: sides){
+            pins.clear();
+        }
+    }
+
+    void end_node(){
+        auto found = buildings.find(building);
+        if (found == buildings.end()){
+            found = buildings.emplace(building, rsc.find_building(building)).first;
+        }
+
+        if (found->second < 0){
+            warn("Unknown building {}", building);
+            return;
+        }
+
+        auto* n = forest.new_node(pos, found->second, rsc.find_recipe(found->second, recipe), rotation);
+
+        for(auto i = 0u; i < 4u; ++i){
+            auto new_side = n->pins[i];
+            assertf(new_side.size() == sides[i].size(), "Side must match");
+
+            for(auto k = 0u; k < new_side.size(); ++k){
+                remap.set(sides[i][k], &new_side[k]);
+            }
+        }
+
+        if (!rules.empty()){
+            forest.set_rules(n, rules);
+        }
+        report();
+    }
+
+    void add_link(std::uint32_t s, std::uint32_t e){
+        auto start_pin = remap.get(s);
+        auto end_pin = remap.get(e);
+
+        if (start_pin == nullptr || end_pin == nullptr){
+            warn("Link {} -> {} is not connected", s, e);
+            return;
+        }
+        forest.new_link(start_pin, end_pin);
+    }
+
+    void end_links(){
+        for(auto& link: pending_links){
+            add_link(link.first, link.second);
+        }
+        pending_links.clear();
+        pending_links.shrink_to_fit();
+    }
+
+    // SAX interface
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+
+    bool number_integer(number_integer_t v) override { number(double(v)); return true; }
+    bool number_unsigned(number_unsigned_t v) override { number(double(v)); return true; }
+    bool number_float(number_float_t v, string_t const&) override { number(double(v)); return true; }
+
+    bool string(string_t& v) override {
+        if (top() == NodeObject){
+            if (current_key == "building") building = v;
+            if (current_key == "recipe")   recipe = v;
+        } else if (top() == RuleObject){
+            if (current_key == "kind")
+                rules.back().kind = json(v).get<SplitterRule::Kind>();
+            if (current_key == "item")
+                rules.back().item = v;
+        }
+        return true;
+    }
+
+    bool binary(binary_t&) override { return true; }
+
+    bool start_object(std::size_t) override {
+        auto frame = child(true);
+        frames.push_back(frame);
+
+        if (frame == NodeObject){
+            begin_node();
+        } else if (frame == LinkObject){
+            start = 0;
+            end = 0;
+        } else if (frame == RuleObject){
+            rules.emplace_back();
+        }
+        return true;
+    }
+
+    bool end_object() override {
+        auto frame = top();
+        frames.pop_back();
+
+        if (frame == NodeObject){
+            end_node();
+        } else if (frame == LinkObject){
+            if (nodes_loaded){
+                add_link(start, end);
+            } else {
+                pending_links.emplace_back(start, end);
+            }
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        frames.push_back(child(false));
+        return true;
+    }
+
+    bool end_array() override {
+        auto frame = top();
+        frames.pop_back();
+
+        if (frame == Side){
+            side += 1;
+        } else if (frame == Nodes){
+            nodes_loaded = true;
+            end_links();
+        }
+        return true;
+    }
+
+    bool key(string_t& k) override {
+        current_key = k;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, std::string const&, nlohmann::detail::exception const& ex) override {
+        warn("Save could not be parsed at {}: {}", position, ex.what());
+        return false;
+    }
+};
+
+}
+
+void Forest::import_json(std::string const& filename, bool clear, PinRemap* pins, LoadProgress const& progress){
+    auto path = puzzle::binary_path() + "/saves/" + filename + ".json";
+    std::ifstream save_file(path, std::ios::in | std::ios::binary);
+
+    if (!save_file){
+        warn("File was not found:{} ", path);
+        return;
+    }
+
+    if (clear){
+        this->clear();
+    }
+
+    PinRemap remap_id;
+    auto size = float(std::max<std::uintmax_t>(std::filesystem::file_size(path), 1));
+    ForestLoader loader(*this, pins != nullptr ? *pins : remap_id, save_file, size, progress);
+
+    begin_batch();
+    json::sax_parse(save_file, &loader);
+
+    // a save without nodes
+    loader.end_links();
+    commit();
+
+    if (progress){
+        progress(1.f);
+    }
+}
@@ -4,8 +4,8 @@
 #include "application/logger.h"
 
 
-NodeLink::NodeLink(Pin const* s, Pin const* e):
-    ID(next_id<std::size_t>()), start(s), end(e)
+NodeLink::NodeLink(std::uint32_t id, Pin const* s, Pin const* e):
+    ID(id), start(s), end(e)
 {
     assertf(start != nullptr, "start cannot be null");
     assertf(end   != nullptr, "end cannot be null");
@@ -26,7 +26,7 @@ void LinkDragDropState::set_starting_point(ImVec2 pos, Pin const* s){
         start_point = pos;
         start = s;
         release = false;
-        debug("Starting new link from ({}, {})", s->parent->ID, s->index);
+        debug("Starting new link from ({}, {})", s->parent->ID, int(s->index));
     }
 }
 
@@ -71,7 +71,7 @@ void LinkDragDropState::make_new_link(NodeEditor* editor){
 void LinkDragDropState::set_end_point(Pin const* e){
     if (should_draw_path && e->parent != start->parent){
         if (end != nullptr && end->ID != e->ID){
-            debug("End new link to ({}, {}) {}", e->parent->ID, e->index, release);
+            debug("End new link to ({}, {}) {}", e->parent->ID, int(e->index), release);
         }
 
         end = e;
@@ -6,7 +6,7 @@
 
 // Link between two pins
 struct NodeLink{
-    const std::size_t ID;
+    const std::uint32_t ID;
 
     Pin const* start; // Node outputs
     Pin const* end;   // Node inputs
@@ -19,7 +19,7 @@ struct NodeLink{
         return end;
     }
 
-    NodeLink(Pin const* s, Pin const* e);
+    NodeLink(std::uint32_t id, Pin const* s, Pin const* e);
 
     bool operator== (NodeLink const& obj){
         return obj.start == this->start && obj.end == this->end;
@@ -33,8 +33,6 @@ struct NodeLink{
     ProductionBook production;
 };
 
-using PinToLink = std::unordered_map<std::size_t, NodeLink*>;
-
 struct NodeEditor;
 
 // Link builder helper
@@ -210,13 +210,15 @@ void NodeEditor::draw_selected_info(){
         ImGui::Text("Energy");
         ImGui::Text("Dimension");
         ImGui::Text("ID");
+        ImGui::Text("Line");
 
         ImGui::NextColumn();
 
         ImGui::Text("%s", b->name.c_str());
         ImGui::Text("%.2f", b->energy);
         ImGui::Text("%.0f x %.0f", b->w, b->l);
-        ImGui::Text("%lu", selected_node->ID);
+        ImGui::Text("%u", selected_node->ID);
+        ImGui::Text("%u", graph.component(selected_node));
 
         ImGui::Separator();
         ImGui::Columns(1);
@@ -229,13 +231,15 @@ void NodeEditor::draw_selected_info(){
         // Select a new recipe
         available_recipes = &b->recipe_names();
 
+        int recipe = selected_node->recipe_idx;
+
         if (ImGui::Combo(
             "Recipe",
-            &selected_node->recipe_idx,
+            &recipe,
             available_recipes->data(),
             available_recipes->size())){
             need_recompute_prod = true;
-            selected_node->logic->reset();
+            history.set_recipe(selected_node, recipe);
         }
 
         // display selected recipe
@@ -290,8 +294,138 @@ void NodeEditor::draw_selected_info(){
         ImGui::TreePop();
     }
     // Recipe Stop
+
+    // Splitter rules, one per output
+    auto outputs = selected_node->output_pins().size();
+
+    if (selected_node->is_relay() && outputs > 1 && ImGui::TreeNode("Rules", open)){
+        static const char* kinds[] = {"Any", "Item", "Overflow", "None"};
+        auto& items = Resources::instance().items;
+
+        auto* current = graph.find_rules(selected_node);
+        SplitterRules rules = current != nullptr ? *current : SplitterRules();
+        rules.resize(std::max(rules.size(), outputs));
+        bool changed = false;
+
+        for(auto i = 0u; i < outputs; ++i){
+            ImGui::PushID(int(i));
+            auto& rule = rules[i];
+
+            int kind = int(rule.kind);
+            ImGui::SetNextItemWidth(ImGui::GetWindowWidth() * 0.3f);
+            if (ImGui::Combo("##kind", &kind, kinds, IM_ARRAYSIZE(kinds))){
+                rule.kind = SplitterRule::Kind(kind);
+                changed = true;
+            }
+
+            if (rule.kind == SplitterRule::Item){
+                ImGui::SameLine();
+
+                if (ImGui::BeginCombo("##item", rule.item.c_str())){
+                    for(auto& item: items){
+                        if (ImGui::Selectable(item.c_str(), item == rule.item)){
+                            rule.item = item;
+                            changed = true;
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+            }
+            ImGui::PopID();
+        }
+
+        if (ImGui::Button("Even split")){
+            rules.clear();
+            changed = true;
+        }
+
+        if (changed){
+            history.set_rules(selected_node, rules);
+        }
+        ImGui::TreePop();
+    }
+
     draw_production(selected_node->production(), selected_node->efficiency);
 
     ImGui::TreePop();
 }
 
+
+void NodeEditor::handle_canvas_input(ImDrawList* draw_list, ImVec2 offset){
+    ImGuiIO& io = ImGui::GetIO();
+    auto mouse = io.MousePos - offset;
+
+    // pins are widgets and have precedence
+    bool canvas_hovered = ImGui::IsWindowHovered() && !ImGui::IsAnyItemHovered() && !link_builder.should_draw_path;
+
+    if (canvas_hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Left)){
+        Node* hit = node_hovered_in_scene;
+
+        if (hit != nullptr){
+            if (!selection.contains(hit)){
+                if (!io.KeyShift)
+                    selection.clear();
+                selection.add(hit);
+            }
+
+            select_node(hit);
+            node_selected = hit;
+
+            drag = DragState::Moving;
+            drag_origins.clear();
+            for(auto* node: selection){
+                drag_origins.push_back(node->Pos);
+            }
+        } else {
+            if (!io.KeyShift)
+                selection.clear();
+
+            drag = DragState::Band;
+            band_start = mouse;
+        }
+    }
+
+    switch (drag){
+    case DragState::Moving:
+        if (ImGui::IsMouseDragging(ImGuiMouseButton_Left)){
+            graph.move_nodes(selection, io.MouseDelta);
+        }
+
+        // snap and record the move once the selection is dropped
+        if (ImGui::IsMouseReleased(ImGuiMouseButton_Left)){
+            history.begin_step();
+            for(std::size_t i = 0; i < selection.size(); ++i){
+                auto* node = selection.nodes[i];
+                graph.move_node(node, snap(node->Pos));
+                history.moved(node, drag_origins[i]);
+            }
+            history.end_step();
+            drag = DragState::None;
+        }
+        break;
+
+    case DragState::Band: {
+        Box band = {ImMin(band_start, mouse), ImMax(band_start, mouse)};
+
+        draw_list->AddRectFilled(offset + band.min, offset + band.max, IM_COL32(100, 130, 200, 40));
+        draw_list->AddRect(offset + band.min, offset + band.max, IM_COL32(100, 130, 200, 200));
+
+        if (ImGui::IsMouseReleased(ImGuiMouseButton_Left)){
+            graph.query(band, [this](Node* node){
+                selection.add(node);
+            });
+            drag = DragState::None;
+        }
+        break;
+    }
+
+    case DragState::None:
+        break;
+    }
+
+    // Open context menu
+    if (ImGui::IsMouseReleased(ImGuiMouseButton_Right) && ImGui::IsWindowHovered(ImGuiHoveredFlags_AllowWhenBlockedByPopup)){
+        node_selected = node_hovered_in_scene;
+        open_context_menu = true;
+    }
+}
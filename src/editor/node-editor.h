@@ -1,6 +1,10 @@
 #ifndef PUZZLE_EDITOR_HEADER
 #define PUZZLE_EDITOR_HEADER
 
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <memory>
 #include <sstream>
 
 #include "config.h"
@@ -12,6 +16,11 @@
 #include "node.h"
 #include "link.h"
 #include "forest.h"
+#include "history.h"
+#include "journal.h"
+#include "tiled_save.h"
+#include "clipboard.h"
+#include "selection.h"
 
 // Draw a bezier curve using only 2 points
 // derive the two other points needed from the starting points
@@ -28,8 +37,15 @@ ImVec2 snap(ImVec2 pos, float snap_factor = 20.f){
 }
 
 
-// R: Rotate
+// R: Rotate the selection (or the node under the mouse)
 // Q: Copy building to brush
+// Delete: Remove the selection
+// Shift+Click: Add to the selection
+// Drag on empty space: Box selection
+// Ctrl+Z: Undo
+// Ctrl+Y: Redo
+// Ctrl+C: Copy the selection
+// Ctrl+V: Paste under the mouse
 //
 // TODO:
 //  - WASD: move scroll area
@@ -48,13 +64,18 @@ bool TreeNode(const char* label, ImGuiTreeNodeFlags flag)
 struct NodeEditor{
     puzzle::Application* app = nullptr;
     Forest               graph;
+    History              history;
+    std::unique_ptr<Journal> journal;
+    std::unique_ptr<TiledSave> streaming;
+    Clipboard            clipboard;
+    int                  paste_count = 1;
     Simulation           sim;
     Brush                brush;
     ImVec2               scrolling = ImVec2(0.0f, 0.0f);
     LinkDragDropState    link_builder;
 
     NodeEditor(puzzle::Application* app = nullptr):
-        app(app), sim(&graph)
+        app(app), history(graph), sim(&graph)
     {
         inited = true;
     }
@@ -66,6 +87,9 @@ struct NodeEditor{
     // Draw a list of nodes on the left side
     bool open_context_menu = false;
 
+    // Nodes drawn this frame
+    std::vector<Node*> visible;
+
     // Node Selection
     Node* node_selected         = nullptr;
     Node* node_hovered_in_list  = nullptr;
@@ -80,12 +104,171 @@ struct NodeEditor{
     const float  NODE_SLOT_RADIUS     = 1.0f * Node::scaling;
     const ImVec2 NODE_WINDOW_PADDING = {10.0f, 10.0f};
 
+    // Box selection
+    enum class DragState {
+        None,
+        Moving,     // moving the selection
+        Band        // drawing the selection rectangle
+    };
+
+    Selection           selection;
+    DragState           drag = DragState::None;
+    ImVec2              band_start;
+    std::vector<ImVec2> drag_origins;   // position of the selection before the move
+
     // Forest functionality forwarding for a nicer API
-    NodeLink* new_link   (Pin const* s, Pin const* e){  need_recompute_prod = true; return graph.new_link(s, e);     }
-    void      remove_link(NodeLink* link)            {  need_recompute_prod = true; return graph.remove_link(link);  }
-    void      remove_node(Node* node)                {  need_recompute_prod = true; return graph.remove_node(node);  }
+    // edits go through the history so they can be undone
+    NodeLink* new_link   (Pin const* s, Pin const* e){  need_recompute_prod = true; return history.new_link(s, e);     }
+    void      remove_link(NodeLink* link)            {  need_recompute_prod = true; return history.remove_link(link);  }
+    void      remove_node(Node* node)                {  need_recompute_prod = true; return history.remove_node(node);  }
     Node*     new_node   (ImVec2 pos, int building, int recipe, int rotation = 0){
-        return graph.new_node(pos, building, recipe, rotation);
+        return history.new_node(pos, building, recipe, rotation);
+    }
+
+    // Remove a group of nodes in a single pass and a single undo step
+    void remove_nodes(std::vector<Node*> const& nodes){
+        history.remove_nodes(nodes);
+        clear_selection();
+    }
+
+    void rotate(std::vector<Node*> const& nodes){
+        history.begin_step();
+        for(auto* node: nodes){
+            history.rotate_node(node, (node->rotation + 1) % 4);
+        }
+        history.end_step();
+    }
+
+    // Paste the clipboard, the new nodes become the selection
+    void paste(ImVec2 pos){
+        auto& created = clipboard.paste(history, pos, paste_count);
+        need_recompute_prod = true;
+
+        selection.clear();
+        for(auto* node: created){
+            selection.add(node);
+        }
+    }
+
+    // Undo/Redo can delete nodes and links, nothing should point to them anymore
+    void undo(){
+        if (history.undo()){
+            clear_selection();
+        }
+    }
+
+    void redo(){
+        if (history.redo()){
+            clear_selection();
+        }
+    }
+
+    static std::string save_path(std::string const& name){
+        return puzzle::binary_path() + "/saves/" + name + ".bin";
+    }
+
+    // Open a save for editing, the edits are journaled next to it
+    // a journal left by a crash is replayed on top of the save.
+    // The save is loaded on a worker thread started at the beginning of the next frame,
+    // nothing drawn in the current one walks the forest while it is loaded.
+    // The editor shows the progress and does not touch the forest until it is done (see draw_loading)
+    void open_save(std::string const& name){
+        opening = name;
+    }
+
+    // Start loading the save requested by open_save, before anything is drawn
+    void start_loading(){
+        if (opening.empty() || loading.valid())
+            return;
+
+        auto name = std::move(opening);
+        opening.clear();
+
+        history.set_journal(nullptr);
+        streaming.reset();
+        sim.set_missing_regions(0);
+        journal = std::make_unique<Journal>(graph, save_path(name));
+
+        // Reset everything to not point to a deleted node
+        history.clear();
+        clear_selection();
+
+        loading_name = name;
+        load_progress = 0.f;
+        loading = std::async(std::launch::async, [this, name](){
+            return load_save(name, [this](float progress){ load_progress = progress; });
+        });
+    }
+
+    // Body of open_save, runs on the loading thread
+    // returns the compaction converting a JSON save, if any
+    std::shared_future<bool> load_save(std::string const& name, LoadProgress const& progress){
+        if (!std::filesystem::exists(journal->path())){
+            // JSON saves are converted by their first compaction
+            graph.load(name, true, nullptr, progress);
+
+            if (graph.node_count() > 0){
+                return journal->compact();
+            }
+        } else if (journal->recoverable() > 0){
+            info("Recovered {} edits of {}", journal->recover(), name);
+        } else {
+            // the tiles in view are loaded first, see draw_workspace
+            streaming = std::make_unique<TiledSave>(graph, journal->path());
+
+            if (!streaming->valid()){
+                streaming.reset();
+            }
+            journal->attach();
+        }
+        return std::shared_future<bool>();
+    }
+
+    // Progress of the save being opened, true until it is loaded
+    bool draw_loading(){
+        if (!loading.valid())
+            return false;
+
+        if (loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+            ImGui::Text("Loading %s", loading_name.c_str());
+            ImGui::ProgressBar(load_progress.load());
+            return true;
+        }
+
+        auto compaction = loading.get();
+        if (compaction.valid()){
+            pending_save = compaction;
+        }
+        compress_save = journal->compressed();
+
+        history.clear();
+        history.set_journal(journal.get());
+        clear_selection();
+        return false;
+    }
+
+    // Finish loading a streamed save
+    void load_remaining_tiles(){
+        if (streaming){
+            streaming->load_all();
+            streaming.reset();
+            sim.set_missing_regions(0);
+        }
+    }
+
+    // Tiles of a streamed save loaded every frame, on top of the ones in view
+    static constexpr std::size_t tiles_per_frame = 2;
+
+    void clear_selection(){
+        selected_node = nullptr;
+        selected_link = nullptr;
+        node_selected = nullptr;
+        node_hovered_in_list = nullptr;
+        node_hovered_in_scene = nullptr;
+        selection.clear();
+        drag = DragState::None;
+        link_builder.reset();
+        need_recompute_prod = true;
     }
 
     void select_link(NodeLink* link){
@@ -111,6 +294,16 @@ struct NodeEditor{
     
     void draw_node(Node* node, ImDrawList* draw_list, ImVec2 offset);
 
+    // Hit testing, selection and moves on the canvas
+    void handle_canvas_input(ImDrawList* draw_list, ImVec2 offset);
+
+    // Nodes the context menu and shortcuts apply to
+    std::vector<Node*> target_nodes(Node* node){
+        if (node != nullptr && !selection.contains(node))
+            return {node};
+        return selection.nodes;
+    }
+
     void reset(){
         node_hovered_in_scene = nullptr;
         link_selected = false;
@@ -136,6 +329,29 @@ struct NodeEditor{
         const ImVec2 offset = ImGui::GetCursorScreenPos() + scrolling;
         ImDrawList* draw_list = ImGui::GetWindowDrawList();
 
+        // Visible part of the canvas
+        Box view = {
+            ImGui::GetCursorScreenPos() - offset,
+            ImGui::GetCursorScreenPos() - offset + ImGui::GetWindowSize()
+        };
+
+        // Tiles of the save around the view first, then a few others per frame
+        if (streaming){
+            streaming->load(view);
+            streaming->load_next(tiles_per_frame);
+            sim.set_missing_regions(streaming->missing_count());
+
+            for(auto& tile: streaming->missing()){
+                if (tile.overlaps(view)){
+                    draw_list->AddRectFilled(offset + tile.min, offset + tile.max, IM_COL32(40, 40, 45, 200));
+                }
+            }
+
+            if (streaming->complete()){
+                streaming.reset();
+            }
+        }
+
         // Display grid
         if (show_grid)
         {
@@ -159,8 +375,18 @@ struct NodeEditor{
         for(auto& iter: graph.iter_links()){
             NodeLink* link = &iter;
 
-            auto p1 = offset + link->start->position();
-            auto p2 = offset + link->end->position();
+            auto p1 = link->start->position();
+            auto p2 = link->end->position();
+
+            // the control points of the bezier curves are inside the rectangle
+            // of their end points so the curve is too, skip the links that cannot be seen
+            auto margin = ImVec2(2.f * Node::scaling, 2.f * Node::scaling);
+            Box bb = {ImMin(p1, p2) - margin, ImMax(p1, p2) + margin};
+            if (!bb.overlaps(view))
+                continue;
+
+            p1 = offset + p1;
+            p2 = offset + p2;
 
             auto color = IM_COL32(200, 200, 100, 200);
 
@@ -183,8 +409,29 @@ struct NodeEditor{
         // Display nodes
         link_builder.start_drag();
 
-        for (auto& node: graph.iter_nodes()){
-            draw_node(&node, draw_list, offset);
+        // Nodes are not widgets, find the one under the mouse
+        if (ImGui::IsWindowHovered()){
+            node_hovered_in_scene = graph.node_at(io.MousePos - offset);
+        }
+
+        // Only draw the nodes on screen
+        // collected first because drawing can move them
+        visible.clear();
+        graph.query(view, [this](Node* node){
+            visible.push_back(node);
+        });
+
+        for (auto* node: visible){
+            draw_node(node, draw_list, offset);
+        }
+
+        // Snap the link being drawn to the closest pin
+        if (link_builder.should_draw_path && !link_builder.is_hovering){
+            auto pin = graph.nearest_pin(ImGui::GetMousePos() - offset, 2.f * NODE_SLOT_RADIUS);
+
+            if (pin != nullptr){
+                link_builder.set_end_point(pin);
+            }
         }
 
         link_builder.draw_path(draw_list);
@@ -194,29 +441,35 @@ struct NodeEditor{
 
         draw_list->ChannelsMerge();
 
-        // Open context menu
-        if (ImGui::IsMouseReleased(ImGuiMouseButton_Right)){
-            if (ImGui::IsWindowHovered(ImGuiHoveredFlags_AllowWhenBlockedByPopup) || !ImGui::IsAnyItemHovered()){
-                node_selected = node_hovered_in_list = node_hovered_in_scene = nullptr;
-                open_context_menu = true;
-            }
+        handle_canvas_input(draw_list, offset);
+
+        if (ImGui::IsKeyReleased(SDL_SCANCODE_Q) && selected_node != nullptr){
+            brush.set(selected_node->building, selected_node->recipe_idx, selected_node->rotation);
         }
 
-        // Select node and show stats
-        if (ImGui::IsMouseReleased(ImGuiMouseButton_Left)){
-            if (node_hovered_in_scene != nullptr) {
-                select_node(node_hovered_in_scene);
-            }
+        if (io.KeyCtrl && ImGui::IsKeyReleased(SDL_SCANCODE_C)){
+            clipboard.copy(graph, target_nodes(selected_node));
         }
 
-        if (ImGui::IsKeyReleased(SDL_SCANCODE_Q) && selected_node != nullptr){
-            brush.set(selected_node->building, selected_node->recipe_idx, selected_node->rotation);
+        if (io.KeyCtrl && ImGui::IsKeyReleased(SDL_SCANCODE_V) && !clipboard.empty()){
+            paste(snap(ImGui::GetMousePos() - offset));
+        }
+
+        if (!io.KeyCtrl && ImGui::IsKeyReleased(SDL_SCANCODE_R)){
+            rotate(target_nodes(node_hovered_in_scene));
+        }
+
+        if (io.KeyCtrl && ImGui::IsKeyReleased(SDL_SCANCODE_Z)){
+            undo();
+        }
+
+        if (io.KeyCtrl && ImGui::IsKeyReleased(SDL_SCANCODE_Y)){
+            redo();
         }
 
         if (ImGui::IsKeyReleased(SDL_SCANCODE_DELETE)){
-            if (selected_node != nullptr){
-                remove_node(selected_node);
-                selected_node = nullptr;
+            if (!selection.empty() || selected_node != nullptr){
+                remove_nodes(target_nodes(selected_node));
             }
 
             if (selected_link != nullptr){
@@ -243,11 +496,15 @@ struct NodeEditor{
 
             if (node)
             {
-                ImGui::Text("Node '%lu'", node->ID);
+                ImGui::Text("Node '%u'", node->ID);
                 ImGui::Separator();
                 if (ImGui::MenuItem("Rename..", nullptr, false, false)) {}
-                if (ImGui::MenuItem("Delete", nullptr, false, false)) {}
-                if (ImGui::MenuItem("Copy", nullptr, false, false)) {}
+                if (ImGui::MenuItem("Delete")) {
+                    remove_nodes(target_nodes(node));
+                }
+                if (ImGui::MenuItem("Copy")) {
+                    clipboard.copy(graph, target_nodes(node));
+                }
             }
             else
             {
@@ -255,8 +512,13 @@ struct NodeEditor{
                     debug("New node");
                     new_node(snap(scene_pos), brush.building, brush.recipe, brush.rotation % 4);
                 }
-                if (ImGui::MenuItem("Paste", nullptr, false, false)) {
+                if (ImGui::MenuItem("Paste", nullptr, false, !clipboard.empty())) {
+                    paste(snap(scene_pos));
+                }
 
+                // copies are pasted below each other
+                if (ImGui::InputInt("Copies", &paste_count)){
+                    paste_count = std::max(paste_count, 1);
                 }
             }
 
@@ -433,7 +695,20 @@ struct NodeEditor{
 
     std::string save_name = std::string(256, '\0');
     bool override_save = false;
+    bool compress_save = false;
     bool clear_on_load = false;
+    std::shared_future<bool> pending_save;
+    std::string       save_status;
+    double            last_autosave = 0;
+
+    // save being opened, see open_save
+    std::string        opening;
+    std::future<std::shared_future<bool>> loading;
+    std::atomic<float> load_progress = 0.f;
+    std::string        loading_name;
+
+    // seconds between two writes of the journal
+    static constexpr double autosave_interval = 5.0;
     bool need_recompute_prod = true;
     ProductionStats prod_stats;
 
@@ -444,31 +719,83 @@ struct NodeEditor{
             ImGui::Checkbox("Override", &override_save);
             ImGui::SameLine();
             ImGui::Checkbox("Clear on Load", &clear_on_load);
+            ImGui::SameLine();
+            ImGui::Checkbox("Compress", &compress_save);
         ImGui::EndGroup();
 
         auto width = (ImGui::GetWindowWidth() - 20) / 2.f;
 
         ImGui::BeginGroup();
             if (ImGui::Button("Save", ImVec2(width, 0))){
-                graph.save(std::string(save_name.c_str()), override_save);
+                // one save at a time
+                if (!pending_save.valid()){
+                    auto path = save_path(std::string(save_name.c_str()));
+
+                    // the tiles not loaded yet would be missing from the save
+                    load_remaining_tiles();
+
+                    if (journal && journal->path() == path){
+                        journal->set_compressed(compress_save);
+                        pending_save = journal->compact();
+                        save_status = "Saving...";
+                    } else if (std::filesystem::exists(path) && !override_save){
+                        warn("File exist:{} ", path);
+                        save_status = "Save failed";
+                    } else {
+                        // the edits are journaled next to the new save from now on
+                        history.set_journal(nullptr);
+                        journal = std::make_unique<Journal>(graph, path);
+                        history.set_journal(journal.get());
+
+                        journal->set_compressed(compress_save);
+                        pending_save = journal->compact();
+                        save_status = "Saving...";
+                    }
+                }
                 override_save = false;
             }
 
             ImGui::SameLine();
 
             if (ImGui::Button("Load", ImVec2(width, 0))){
-                graph.load(std::string(save_name.c_str()), clear_on_load);
+                if (clear_on_load){
+                    open_save(std::string(save_name.c_str()));
+                } else {
+                    load_remaining_tiles();
+                    graph.load(std::string(save_name.c_str()), false);
+
+                    // the merged nodes are not in the journal
+                    if (journal){
+                        pending_save = journal->compact();
+                    }
+
+                    // Reset everything to not point to a deleted node
+                    history.clear();
+                    clear_selection();
+                }
                 clear_on_load = false;
-
-                // Reset everything to not point to a deleted node
-                selected_node = nullptr;
-                selected_link = nullptr;
-                node_selected = nullptr;
-                node_hovered_in_list = nullptr;
-                node_hovered_in_scene = nullptr;
-                need_recompute_prod = true;
             }
         ImGui::EndGroup();
+
+        // saves/<name>.json, readable by older versions and other tools
+        if (ImGui::Button("Export JSON", ImVec2(-1, 0))){
+            // the tiles not loaded yet would be missing from the export
+            load_remaining_tiles();
+
+            auto exported = graph.export_json(std::string(save_name.c_str()), override_save);
+            save_status = exported ? "Exported" : "Export failed";
+            override_save = false;
+        }
+
+        // the save is written in the background, poll it every frame
+        if (pending_save.valid() && pending_save.wait_for(std::chrono::seconds(0)) == std::future_status::ready){
+            save_status = pending_save.get() ? "Saved" : "Save failed";
+            pending_save = std::shared_future<bool>();
+        }
+
+        if (save_status.size() > 0){
+            ImGui::Text("%s", save_status.c_str());
+        }
     }
 
     void draw_production(ProductionBook const& prod, float efficiency);
@@ -517,6 +844,8 @@ struct NodeEditor{
     void draw_overall_performance();
 
     void draw(){
+        start_loading();
+
         ImGui::SetNextWindowSize(ImVec2(700, 600), ImGuiCond_FirstUseEver);
         if (!ImGui::Begin("Factory Blueprint", &opened))
         {
@@ -524,9 +853,20 @@ struct NodeEditor{
             return;
         }
 
+        if (draw_loading()){
+            ImGui::End();
+            return;
+        }
+
         // simulation bit
         sim.compute_production();
 
+        // the edits made since the last autosave are appended to the journal
+        if (journal && ImGui::GetTime() - last_autosave > autosave_interval){
+            journal->autosave(streaming == nullptr);
+            last_autosave = ImGui::GetTime();
+        }
+
 //        if (need_recompute_prod) {
 //            prod_stats = graph.compute_production();
 //            need_recompute_prod = false;
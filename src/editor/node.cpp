@@ -1,15 +1,8 @@
 #include "node.h"
 #include "factory/simulation.h"
 
-bool Node::is_pipeline_cross() const {
-    if (descriptor->name == "Pipeline Junction Cross (S)" || descriptor->name == "Pipeline Junction Cross (M)"){
-        return true;
-    }
-    return false;
-}
-
-Node::Node(int building, const ImVec2& pos, int recipe_idx, int rotation):
-    ID(next_id<std::size_t>()), building(building), recipe_idx(recipe_idx), rotation(rotation), pins(4)
+Node::Node(std::uint32_t id, std::uint32_t first_pin_id, int building, const ImVec2& pos, int recipe_idx, int rotation):
+    ID(id), building(building), recipe_idx(recipe_idx), rotation(rotation)
 {
     assertf(building >= 0, "Node should have a building");
 
@@ -19,10 +12,7 @@ Node::Node(int building, const ImVec2& pos, int recipe_idx, int rotation):
         int pin_side = get_side(side.first);
         std::vector<std::string>& pin_str = side.second;
 
-        std::vector<Pin>& side_pins = pins[std::size_t(get_side(side.first))];
-        side_pins.reserve(side.second.size());
-
-        for(int i = 0, n = pin_str.size(); i < n; ++i) {
+        for(int i = 0, n = int(pin_str.size()); i < n; ++i) {
             auto& p = pin_str[std::size_t(i)];
             assertf(p.size() == 2,
                     "Pin descriptor is of size 2");
@@ -33,7 +23,8 @@ Node::Node(int building, const ImVec2& pos, int recipe_idx, int rotation):
             assertf(p[1] == 'I' || p[1] == 'O',
                     "Pin type should be defined");
 
-            add_pin(get_side(side.first),
+            add_pin(first_pin_id + std::uint32_t(pins.size()),
+                    pin_side,
                     p[0],           // Belt Type
                     p[1] == 'I',    // Input
                     pin_side,       // Pin Side
@@ -44,34 +35,31 @@ Node::Node(int building, const ImVec2& pos, int recipe_idx, int rotation):
     Pos = pos;
 }
 
-void Node::add_pin(int side, char type, bool input, int pin_side, int i, int n){
-    std::vector<Pin>& side_array = pins[std::size_t(side)];
-    side_array.emplace_back(type, input, pin_side, i, n, this);
+void Node::add_pin(std::uint32_t id, int side, char type, bool input, int pin_side, int i, int n){
+    auto bit = std::uint8_t(1u << pins.size());
+    pins.emplace(std::size_t(side), id, type, input, pin_side, i, n, this);
 
     if (is_pipeline_cross()){
-        input_pins.emplace_back(&*side_array.rbegin());
-        output_pins.emplace_back(&*side_array.rbegin());
+        input_mask  |= bit;
+        output_mask |= bit;
     } else if (input){
-        input_pins.emplace_back(&*side_array.rbegin());
+        input_mask  |= bit;
     } else {
-        output_pins.emplace_back(&*side_array.rbegin());
+        output_mask |= bit;
     }
 }
 
-void Node::update_size(ImVec2){
-    ImVec2 base = {scaling * descriptor->l, scaling *descriptor->w};
-    _size = base;
-}
-
 ImVec2 Node::size() const {
+    ImVec2 base = {scaling * descriptor->l, scaling * descriptor->w};
+
     switch (Direction(rotation)){
     case LeftToRight:
     case RightToLeft:
-        return _size;
+        return base;
 
     case TopToBottom:
     case BottomToTop:
-        return ImVec2(_size.y, _size.x);
+        return ImVec2(base.y, base.x);
     }
 
     __builtin_unreachable();
@@ -141,15 +129,12 @@ Recipe* Node::recipe() const {
 #include "node-editor.h"
 
 void NodeEditor::draw_node(Node* node, ImDrawList* draw_list, ImVec2 offset){
-    ImGuiIO& io = ImGui::GetIO();
-
-    ImGui::PushID(node->ID);
+    ImGui::PushID(int(node->ID));
     ImVec2 node_rect_min = offset + node->Pos;
 
     // Display node contents first
     draw_list->ChannelsSetCurrent(1); // Foreground
 
-    bool old_any_active = ImGui::IsAnyItemActive();
     ImGui::SetCursorScreenPos(node_rect_min + NODE_WINDOW_PADDING);
     ImGui::BeginGroup(); // Lock horizontal position
 
@@ -169,46 +154,31 @@ void NodeEditor::draw_node(Node* node, ImDrawList* draw_list, ImVec2 offset){
         }
     }
 
-    // Save the size of what we have emitted and whether any of the widgets are being used
-    bool node_widgets_active = (!old_any_active && ImGui::IsAnyItemActive());
-    node->update_size(ImGui::GetItemRectSize() + NODE_WINDOW_PADDING + NODE_WINDOW_PADDING);
     ImVec2 node_rect_max = node_rect_min + node->size();
 
     // Display node box
+    // nodes are not widgets, hovering and dragging is handled by the canvas
     draw_list->ChannelsSetCurrent(0); // Background
-    ImGui::SetCursorScreenPos(node_rect_min);
-    ImGui::InvisibleButton("node", node->size());
-
-    if (ImGui::IsItemHovered()){
-        node_hovered_in_scene = node;
-        open_context_menu |= ImGui::IsMouseClicked(1);
-    }
-
-    bool node_moving_active = ImGui::IsItemActive();
-
-    if (node_widgets_active || node_moving_active)
-        node_selected = node;
-
-    if (node_moving_active && ImGui::IsMouseDragging(ImGuiMouseButton_Left)){
-        node->Pos = node->Pos + io.MouseDelta;
-    } else {
-        node->Pos = snap(node->Pos);
-    }
-
-    // Shortcuts
-    if (ImGui::IsItemHovered()) {
-        if (ImGui::IsKeyReleased(SDL_SCANCODE_R)){
-            node->rotation = (node->rotation + 1) % 4;
-        }
-    }
 
     // Draw rectangle
     ImU32 node_bg_color = IM_COL32(60, 60, 60, 255);
     if (node_hovered_in_list == node || node_hovered_in_scene == node || (!node_hovered_in_list && node_selected == node))
         node_bg_color = IM_COL32(75, 75, 75, 255);
 
+    if (selection.contains(node))
+        node_bg_color = IM_COL32(90, 90, 110, 255);
+
+    // Highlight what feeds the selected node and what it feeds
+    ImU32 node_border_color = IM_COL32(100, 100, 100, 255);
+    if (selected_node != nullptr && selected_node != node){
+        if (graph.feeds(node, selected_node))
+            node_border_color = IM_COL32(80, 140, 220, 255);
+        else if (graph.feeds(selected_node, node))
+            node_border_color = IM_COL32(90, 200, 110, 255);
+    }
+
     draw_list->AddRectFilled(node_rect_min, node_rect_max, node_bg_color, 4.0f);
-    draw_list->AddRect(node_rect_min, node_rect_max, IM_COL32(100, 100, 100, 255), 4.0f);
+    draw_list->AddRect(node_rect_min, node_rect_max, node_border_color, 4.0f);
 
     ImGui::PopID();
 }
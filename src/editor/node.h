@@ -8,7 +8,6 @@
 #include "factory/simulation.h"
 
 #include <array>
-#include <unordered_set>
 
 
 struct Node {
@@ -16,54 +15,49 @@ struct Node {
     // building scale
     static float constexpr scaling = 10.f;
 
-    const std::size_t ID;
-    ImVec2            Pos;
-    ImVec2            _size;
-    Building*         descriptor = nullptr;
-    int               building   = -1;
-    int               recipe_idx = -1;
-    int               rotation   =  0;
-    float             efficiency =  0.f;
-    SimualtionStep    logic      = nullptr;
+    const std::uint32_t ID;
+    ImVec2              Pos;
+    Building*           descriptor = nullptr;
+    int                 building   = -1;
+    int                 recipe_idx = -1;
+    int                 rotation   =  0;
+    float               efficiency =  0.f;
+    SimualtionStep      logic      = nullptr;
 
     ProductionBook const& production () const {
         return logic->production;
     }
 
-    bool is_pipeline_cross() const;
+    bool is_pipeline_cross() const {
+        return descriptor->kind == BuildingKind::PipelineCross;
+    }
 
-    std::vector<std::vector<Pin>> pins;
+    NodePins pins;
 
-    Recipe* recipe() const;
+    // pipeline cross pins are both inputs and outputs
+    std::uint8_t input_mask  = 0;
+    std::uint8_t output_mask = 0;
 
-    void update_size(ImVec2);
+    Recipe* recipe() const;
 
+    // Size of the building taking rotation into account
     ImVec2 size() const;
 
-    std::vector<Pin*> input_pins;
-    std::vector<Pin*> output_pins;
+    PinSet input_pins()  { return {pins.data(), input_mask};  }
+    PinSet output_pins() { return {pins.data(), output_mask}; }
 
-    void add_pin(int side, char type, bool input, int pin_side, int i, int n);
+    void add_pin(std::uint32_t id, int side, char type, bool input, int pin_side, int i, int n);
 
-    bool is_relay(){
-        static std::unordered_set<std::string> relays = {
-            "Conveyor Splitter",
-            "Conveyor Merger",
-            "Pipeline Junction Cross (S)",
-            "Pipeline Junction Cross (M)",
-            };
-        return relays.count(descriptor->name) == 1;
+    bool is_relay() const {
+        return descriptor->kind == BuildingKind::Relay || is_pipeline_cross();
     }
 
-    bool is_storage(){
-        static std::unordered_set<std::string> relays = {
-            "Storage Container",
-        };
-        return relays.count(descriptor->name) == 1;
+    bool is_storage() const {
+        return descriptor->kind == BuildingKind::Storage;
     }
 
     bool is_input_pipe(int i){
-        return input_pins[std::size_t(i)]->belt_type == 'P';
+        return input_pins()[std::size_t(i)]->belt_type == 'P';
     }
 
     bool is_input_conveyor(int i){
@@ -83,7 +77,11 @@ struct Node {
         return obj.ID == ID;
     }
 
-    Node(int building, const ImVec2& pos, int recipe_idx=-1, int rotation=0);
+    // Nodes are created by the Forest which allocates their IDs
+    // pins get the IDs [first_pin_id, first_pin_id + pin count)
+    Node(std::uint32_t id, std::uint32_t first_pin_id, int building, const ImVec2& pos, int recipe_idx=-1, int rotation=0);
+
+    Node(Node const&) = delete;
 };
 
 #endif
@@ -3,13 +3,13 @@
 #include "application/logger.h"
 
 
-Pin::Pin(char type, bool is_input, int side, int index, int count, Node* parent):
-    ID(next_id<std::size_t>()), belt_type(type), is_input(is_input),
-    side(side), index(index), count(count), parent(parent)
+Pin::Pin(std::uint32_t id, char type, bool is_input, int side, int index, int count, Node* parent):
+    ID(id), belt_type(type), is_input(is_input),
+    side(std::uint8_t(side)), index(std::uint8_t(index)), count(std::uint8_t(count)), parent(parent)
 {}
 
 Pin::Pin(Pin const&& obj) noexcept:
-    ID(obj.ID), belt_type(obj.belt_type), side(obj.side), index(obj.index),
+    ID(obj.ID), belt_type(obj.belt_type), is_input(obj.is_input), side(obj.side), index(obj.index),
     count(obj.count), parent(obj.parent)
 {}
 
@@ -21,7 +21,7 @@ ImVec2 Pin::position() const {
 std::ostream& operator<<(std::ostream& out, Pin const& pin){
     return out << fmt::format(
                "Pin(ID={}, type={}, input={}, side={}, index={}, count={}, parent={})",
-               pin.ID, pin.belt_type, pin.is_input, pin.side, pin.index, pin.count, pin.parent->ID);
+               pin.ID, pin.belt_type, pin.is_input, int(pin.side), int(pin.index), int(pin.count), pin.parent->ID);
 }
 
 
@@ -4,17 +4,22 @@
 #include "utils.h"
 #include "config.h"
 
+#include <bit>
+#include <span>
+#include <cstdint>
+
 struct Node;
 
 // Attachable widget
+// kept small (16 bytes) since every node holds a few of them inline
 struct Pin {
-    const std::size_t ID;
+    const std::uint32_t ID;
     char belt_type = ' ';
     bool is_input  = false;
 
-    int   side         = 0;
-    int   index        = 0;
-    int   count        = 0;
+    std::uint8_t side  : 2;     // side of the node the pin is on
+    std::uint8_t index : 3;     // index of the pin on that side
+    std::uint8_t count : 3;     // number of pins on that side
 
     Node* const parent = nullptr;
 
@@ -27,7 +32,7 @@ struct Pin {
     // We need move for std::vector resize event though it should never get resized
     Pin(Pin const&& obj) noexcept;
 
-    Pin(char type, bool is_input, int side, int index, int count, Node* parent);
+    Pin(std::uint32_t id, char type, bool is_input, int side, int index, int count, Node* parent);
 
     bool compatible(Item const& item){
         return (belt_type == 'C' && item.type == 'S') ||
@@ -38,4 +43,138 @@ struct Pin {
 std::ostream& operator<<(std::ostream& out, Pin const& pin);
 
 
+// Subset of the pins of a node stored as a bit mask over NodePins
+// iterating yields Pin* in storage order
+struct PinSet {
+    Pin*         base = nullptr;
+    std::uint8_t mask = 0;
+
+    struct iterator {
+        Pin*         base;
+        std::uint8_t mask;
+
+        Pin* operator*() const {
+            return base + std::countr_zero(unsigned(mask));
+        }
+
+        iterator& operator++(){
+            mask &= std::uint8_t(mask - 1);
+            return *this;
+        }
+
+        bool operator!= (iterator const& obj) const {
+            return mask != obj.mask;
+        }
+    };
+
+    iterator begin() const { return {base, mask}; }
+    iterator end  () const { return {base, 0}; }
+
+    std::size_t size() const {
+        return std::size_t(std::popcount(unsigned(mask)));
+    }
+
+    // i-th pin of the set
+    Pin* operator[] (std::size_t i) const {
+        auto m = mask;
+        for(; i > 0; --i){
+            m &= std::uint8_t(m - 1);
+        }
+        return base + std::countr_zero(unsigned(m));
+    }
+};
+
+
+// Fixed capacity inline storage for the pins of a node
+// Pins of a side are stored contiguously so pins[side] is a span
+// and no heap allocation is needed
+struct NodePins {
+    // Space Elevator has the most pins (6)
+    static constexpr std::size_t capacity = 6;
+
+    NodePins() = default;
+
+    NodePins(NodePins const&) = delete;
+
+    ~NodePins(){
+        for(auto& pin: all()){
+            pin.~Pin();
+        }
+    }
+
+    // All the pins of a side have to be inserted one after the other
+    template<typename ... Args>
+    Pin& emplace(std::size_t side, Args&& ... args){
+        assertf(total < capacity, "Node has too many pins");
+        assertf(side < 4, "Node has 4 sides");
+
+        if (counts[side] == 0){
+            starts[side] = total;
+        }
+
+        assertf(starts[side] + counts[side] == total, "Pins of a side must be contiguous");
+
+        Pin* pin = new (data() + total) Pin(std::forward<Args>(args)...);
+        counts[side] += 1;
+        total += 1;
+        return *pin;
+    }
+
+    std::span<Pin> operator[] (std::size_t side){
+        return {data() + starts[side], counts[side]};
+    }
+
+    std::span<Pin const> operator[] (std::size_t side) const {
+        return {data() + starts[side], counts[side]};
+    }
+
+    std::span<Pin>       all()       { return {data(), total}; }
+    std::span<Pin const> all() const { return {data(), total}; }
+
+    std::size_t size() const {
+        return total;
+    }
+
+    // Iterate over the sides
+    template<typename P, typename S>
+    struct side_iterator {
+        P* pins;
+        std::size_t side;
+        S current;
+
+        S const& operator*() const {
+            return current;
+        }
+
+        side_iterator& operator++(){
+            side += 1;
+            if (side < 4){
+                current = (*pins)[side];
+            }
+            return *this;
+        }
+
+        bool operator!= (side_iterator const& obj) const {
+            return side != obj.side;
+        }
+    };
+
+    using iterator       = side_iterator<NodePins, std::span<Pin>>;
+    using const_iterator = side_iterator<NodePins const, std::span<Pin const>>;
+
+    iterator       begin()       { return {this, 0, (*this)[0]}; }
+    iterator       end  ()       { return {this, 4, {}}; }
+    const_iterator begin() const { return {this, 0, (*this)[0]}; }
+    const_iterator end  () const { return {this, 4, {}}; }
+
+    Pin*       data()       { return reinterpret_cast<Pin*>(storage); }
+    Pin const* data() const { return reinterpret_cast<Pin const*>(storage); }
+
+private:
+    alignas(Pin) unsigned char storage[capacity * sizeof(Pin)];
+    std::uint8_t starts[4] = {0, 0, 0, 0};
+    std::uint8_t counts[4] = {0, 0, 0, 0};
+    std::uint8_t total     = 0;
+};
+
 #endif
@@ -0,0 +1,158 @@
+#include "reachability.h"
+#include "node.h"
+
+// Direction of the edges a link adds to the graph
+// (pipes can go both ways)
+static bool is_output(Pin const* pin){
+    for(auto* p: pin->parent->output_pins()){
+        if (p == pin)
+            return true;
+    }
+    return false;
+}
+
+void Reachability::linked(Pin const* s, Pin const* e){
+    Node* a = s->parent;
+    Node* b = e->parent;
+    auto l = node_line.get(a->ID);
+    source = nullptr;
+
+    // two lines merged (or one was never indexed)
+    if (l == 0 || node_line.get(b->ID) != l){
+        invalidate(a);
+        invalidate(b);
+        return;
+    }
+
+    auto& line = lines[l];
+    if (!line.indexed)
+        return;
+
+    auto sa = node_scc.get(a->ID);
+    auto sb = node_scc.get(b->ID);
+
+    bool ok = true;
+    if (is_output(s)){
+        ok = insert(line, sa, sb);
+    }
+    if (ok && is_output(e)){
+        ok = insert(line, sb, sa);
+    }
+
+    if (!ok){
+        invalidate(a);
+    }
+}
+
+void Reachability::unlinked(Pin const* s, Pin const* e){
+    invalidate(s->parent);
+    invalidate(e->parent);
+}
+
+void Reachability::invalidate(Node const* node){
+    source = nullptr;
+    auto l = node_line.get(node->ID);
+    if (l == 0)
+        return;
+
+    auto& line = lines[l];
+    for(auto* member: line.members){
+        node_line.erase(member->ID);
+    }
+
+    line.members.clear();
+    line.desc.clear();
+    line.anc.clear();
+    free_lines.push_back(l);
+}
+
+bool Reachability::insert(Line& line, std::uint32_t x, std::uint32_t y){
+    // already reachable
+    if (line.test(line.desc, x, y))
+        return true;
+
+    // y reaches x, x -> y closes a cycle and SCCs need to be merged
+    if (line.test(line.desc, y, x))
+        return false;
+
+    // everything reaching x now reaches everything y reaches
+    for(std::uint32_t i = 0; i < line.count; ++i){
+        if (line.test(line.anc, x, i)){
+            line.merge(line.desc, i, y);
+        }
+    }
+
+    for(std::uint32_t j = 0; j < line.count; ++j){
+        if (line.test(line.desc, y, j)){
+            line.merge(line.anc, j, x);
+        }
+    }
+    return true;
+}
+
+std::uint32_t Reachability::strongly_connected(){
+    auto n = std::uint32_t(nodes.size());
+
+    scc.assign(n, none);
+    order.assign(n, none);
+    low.assign(n, 0);
+    stack.clear();
+    calls.clear();
+
+    std::uint32_t counter = 0;
+    std::uint32_t count = 0;
+
+    // nodes on the stack do not have an SCC yet
+    auto on_stack = [this](std::uint32_t v){
+        return order[v] != none && scc[v] == none;
+    };
+
+    auto enter = [&](std::uint32_t v){
+        order[v] = low[v] = counter++;
+        stack.push_back(v);
+        calls.emplace_back(v, adj_offsets[v]);
+    };
+
+    for(std::uint32_t root = 0; root < n; ++root){
+        if (order[root] != none)
+            continue;
+
+        enter(root);
+
+        while (calls.size() > 0){
+            auto v = calls.back().first;
+            auto e = calls.back().second;
+
+            if (e < adj_offsets[v + 1]){
+                calls.back().second += 1;
+                auto w = adj[e];
+
+                if (order[w] == none){
+                    enter(w);
+                } else if (on_stack(w)){
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+
+            // v is the root of an SCC
+            if (low[v] == order[v]){
+                std::uint32_t w = none;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    scc[w] = count;
+                } while (w != v);
+                count += 1;
+            }
+
+            calls.pop_back();
+            if (calls.size() > 0){
+                auto p = calls.back().first;
+                low[p] = std::min(low[p], low[v]);
+            }
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,366 @@
+#ifndef PUZZLE_EDITOR_REACHABILITY_HEADER
+#define PUZZLE_EDITOR_REACHABILITY_HEADER
+
+#include "traversal.h"
+#include "ids.h"
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+struct Node;
+struct Pin;
+
+// Reachability index over the forest
+// answers "does a feed b" in O(1) and lists everything upstream/downstream
+// of a node in O(k) without running a traversal per query.
+//
+// The index is built per production line (connected component), on the
+// condensation of the line (strongly connected components collapsed into one
+// vertex), as a bitset of the descendants and of the ancestors of every SCC.
+// Memory is quadratic in the number of SCCs of a line so lines are only
+// indexed the first time one of their nodes is queried, and lines of more
+// than max_indexed SCCs are not indexed at all: their queries walk the line,
+// keeping what the last node queried reaches and is reached from (the editor
+// asks about the selected node for every node it draws).
+//
+// Links inserted inside an indexed line that do not close a cycle are applied
+// in place, everything else (removals, two lines merging, new cycle) drops
+// the index of the lines involved.
+struct Reachability {
+    // A link was created between the pins s and e
+    void linked(Pin const* s, Pin const* e);
+
+    // The link between the pins s and e was removed
+    void unlinked(Pin const* s, Pin const* e);
+
+    // Drop the index of the line the node belongs to
+    void invalidate(Node const* node);
+
+    void clear(){
+        lines.clear();
+        free_lines.clear();
+        node_line.clear();
+        node_scc.clear();
+        source = nullptr;
+    }
+
+    // true if there is a path from a to b (a node reaches itself)
+    // Graph needs for_each_next(Node*, Flow, fun)
+    template<typename Graph>
+    bool reaches(Graph& graph, Node* a, Node* b){
+        // a line holds a whole connected component, nodes of two lines
+        // or of a line and of a line not indexed yet are not connected
+        auto la = node_line.get(a->ID);
+        auto lb = node_line.get(b->ID);
+
+        if ((la != 0 || lb != 0) && la != lb)
+            return false;
+
+        auto l = index(graph, a);
+
+        if (node_line.get(b->ID) != l)
+            return false;
+
+        if (!lines[l].indexed)
+            return walked(graph, a, b);
+
+        return lines[l].test(lines[l].desc, node_scc.get(a->ID), node_scc.get(b->ID));
+    }
+
+    // Call fun on every node reachable from node following the flow
+    // node itself is included
+    template<typename Graph, typename Fun>
+    void for_each(Graph& graph, Node* node, Flow flow, Fun&& fun){
+        auto& line = lines[index(graph, node)];
+
+        // fun can query the index, the nodes are collected first
+        if (!line.indexed){
+            std::vector<Node*> found;
+            walk(graph, node, flow, found);
+
+            for(auto* next: found){
+                fun(next);
+            }
+            return;
+        }
+
+        auto& sets = flow == Flow::Downstream ? line.desc : line.anc;
+        auto row   = line.row(node_scc.get(node->ID));
+
+        for(std::size_t w = 0; w < line.words; ++w){
+            auto bits = sets[row + w];
+
+            while (bits){
+                auto scc = std::uint32_t(w * 64 + std::size_t(std::countr_zero(bits)));
+                bits &= bits - 1;
+
+                for(auto i = line.offsets[scc]; i < line.offsets[scc + 1]; ++i){
+                    fun(line.members[i]);
+                }
+            }
+        }
+    }
+
+    // Largest number of SCCs of an indexed line, 2 MiB per bitset
+    static constexpr std::uint32_t max_indexed = 4096;
+
+private:
+    static constexpr std::uint32_t none = ~0u;
+
+    struct Line {
+        std::uint32_t count = 0;     // number of SCCs
+        bool          indexed = true;// false if count > max_indexed, no bitsets
+        std::size_t   words = 0;     // words per bitset
+        std::vector<std::uint64_t> desc;
+        std::vector<std::uint64_t> anc;
+        // members grouped by SCC, SCC i is [offsets[i], offsets[i + 1])
+        std::vector<Node*>         members;
+        std::vector<std::uint32_t> offsets;
+
+        std::size_t row(std::uint32_t scc) const {
+            return scc * words;
+        }
+
+        bool test(std::vector<std::uint64_t> const& sets, std::uint32_t i, std::uint32_t j) const {
+            return (sets[row(i) + j / 64] >> (j % 64)) & 1u;
+        }
+
+        void set(std::vector<std::uint64_t>& sets, std::uint32_t i, std::uint32_t j){
+            sets[row(i) + j / 64] |= std::uint64_t(1) << (j % 64);
+        }
+
+        // sets[i] |= sets[j]
+        void merge(std::vector<std::uint64_t>& sets, std::uint32_t i, std::uint32_t j){
+            for(std::size_t w = 0; w < words; ++w){
+                sets[row(i) + w] |= sets[row(j) + w];
+            }
+        }
+    };
+
+    // Returns the line of node, indexing it if necessary
+    template<typename Graph>
+    std::uint32_t index(Graph& graph, Node* node){
+        auto l = node_line.get(node->ID);
+        if (l == 0){
+            l = build(graph, node);
+        }
+        return l;
+    }
+
+    // Add the edge x -> y between two SCCs of a line
+    // returns false if the edge closes a cycle, the line needs to be rebuilt
+    bool insert(Line& line, std::uint32_t x, std::uint32_t y);
+
+    template<typename Graph>
+    std::uint32_t build(Graph& graph, Node* start);
+
+    // Nodes reachable from node following the flow, node included
+    template<typename Graph>
+    void walk(Graph& graph, Node* node, Flow flow, std::vector<Node*>& out);
+
+    // reaches() on a line that is not indexed
+    template<typename Graph>
+    bool walked(Graph& graph, Node* a, Node* b);
+
+    // Tarjan's algorithm on the local adjacency, fills scc
+    // SCCs are numbered in reverse topological order
+    std::uint32_t strongly_connected();
+
+    std::vector<Line>          lines = std::vector<Line>(1);  // 0 is not a line
+    std::vector<std::uint32_t> free_lines;
+    IdMap<std::uint32_t>       node_line;
+    IdMap<std::uint32_t>       node_scc;
+
+    // Build scratch
+    RingQueue<Node*>            queue;
+    StampedArray<std::uint32_t> local;
+    std::vector<Node*>          nodes;
+    std::vector<std::uint32_t>  adj;
+    std::vector<std::uint32_t>  adj_offsets;
+    std::vector<std::uint32_t>  scc;
+    std::vector<std::uint32_t>  order;
+    std::vector<std::uint32_t>  low;
+    std::vector<std::uint32_t>  stack;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> calls;
+
+    // Lines not indexed: the last node queried and what it reaches
+    // and is reached from, dropped by any change
+    Node*              source = nullptr;
+    VisitedSet         downstream;
+    VisitedSet         upstream;
+    VisitedSet         seen;
+    std::vector<Node*> reached;
+};
+
+
+template<typename Graph>
+std::uint32_t Reachability::build(Graph& graph, Node* start){
+    // collect the line, local indices follow the discovery order
+    local.reset();
+    nodes.clear();
+    queue.clear();
+
+    local[start->ID] = 1;
+    queue.push_back(start);
+
+    auto discover = [this](Node* next){
+        auto& i = local[next->ID];
+        if (i == 0){
+            i = 1;
+            queue.push_back(next);
+        }
+    };
+
+    while (!queue.empty()){
+        auto* node = queue.pop_front();
+        local[node->ID] = std::uint32_t(nodes.size()) + 1;
+        nodes.push_back(node);
+
+        graph.for_each_next(node, Flow::Downstream, discover);
+        graph.for_each_next(node, Flow::Upstream, discover);
+    }
+
+    // downstream adjacency (CSR)
+    adj.clear();
+    adj_offsets.clear();
+
+    for(auto* node: nodes){
+        adj_offsets.push_back(std::uint32_t(adj.size()));
+        graph.for_each_next(node, Flow::Downstream, [this](Node* next){
+            adj.push_back(local[next->ID] - 1);
+        });
+    }
+    adj_offsets.push_back(std::uint32_t(adj.size()));
+
+    auto count = strongly_connected();
+
+    // allocate the line
+    std::uint32_t l = 0;
+    if (free_lines.size() > 0){
+        l = free_lines.back();
+        free_lines.pop_back();
+    } else {
+        l = std::uint32_t(lines.size());
+        lines.emplace_back();
+    }
+
+    auto& line  = lines[l];
+    line.count  = count;
+    line.indexed = count <= max_indexed;
+
+    // too large for the bitsets, only the membership is kept
+    if (!line.indexed){
+        line.words = 0;
+        line.members = nodes;
+        line.offsets.clear();
+
+        for(auto* node: nodes){
+            node_line.set(node->ID, l);
+        }
+        return l;
+    }
+
+    line.words  = (count + 63) / 64;
+    line.desc.assign(count * line.words, 0);
+    line.anc.assign(count * line.words, 0);
+
+    // group the members by SCC
+    line.offsets.assign(count + 1, 0);
+    for(auto s: scc){
+        line.offsets[s + 1] += 1;
+    }
+    for(std::uint32_t s = 0; s < count; ++s){
+        line.offsets[s + 1] += line.offsets[s];
+    }
+
+    line.members.resize(nodes.size());
+    order.assign(line.offsets.begin(), line.offsets.end() - 1);
+
+    for(std::size_t i = 0; i < nodes.size(); ++i){
+        line.members[order[scc[i]]++] = nodes[i];
+        node_line.set(nodes[i]->ID, l);
+        node_scc.set(nodes[i]->ID, scc[i]);
+    }
+
+    // Edges go from higher to lower SCC numbers
+    // descendants are complete once all the lower SCCs are done
+    for(std::uint32_t s = 0; s < count; ++s){
+        line.set(line.desc, s, s);
+
+        for(auto i = line.offsets[s]; i < line.offsets[s + 1]; ++i){
+            auto v = local[line.members[i]->ID] - 1;
+
+            for(auto e = adj_offsets[v]; e < adj_offsets[v + 1]; ++e){
+                auto d = scc[adj[e]];
+                if (d != s){
+                    line.merge(line.desc, s, d);
+                }
+            }
+        }
+    }
+
+    // ancestors are complete once all the higher SCCs are done
+    for(std::uint32_t s = count; s-- > 0;){
+        line.set(line.anc, s, s);
+
+        for(auto i = line.offsets[s]; i < line.offsets[s + 1]; ++i){
+            auto v = local[line.members[i]->ID] - 1;
+
+            for(auto e = adj_offsets[v]; e < adj_offsets[v + 1]; ++e){
+                auto d = scc[adj[e]];
+                if (d != s){
+                    line.merge(line.anc, d, s);
+                }
+            }
+        }
+    }
+
+    return l;
+}
+
+template<typename Graph>
+void Reachability::walk(Graph& graph, Node* node, Flow flow, std::vector<Node*>& out){
+    out.clear();
+    queue.clear();
+    seen.reset();
+
+    seen.visit(node->ID);
+    queue.push_back(node);
+
+    while (!queue.empty()){
+        auto* next = queue.pop_front();
+        out.push_back(next);
+
+        graph.for_each_next(next, flow, [this](Node* n){
+            if (seen.visit(n->ID)){
+                queue.push_back(n);
+            }
+        });
+    }
+}
+
+template<typename Graph>
+bool Reachability::walked(Graph& graph, Node* a, Node* b){
+    if (source != a && source != b){
+        source = a;
+        downstream.reset();
+        upstream.reset();
+
+        walk(graph, a, Flow::Downstream, reached);
+        for(auto* node: reached){
+            downstream.visit(node->ID);
+        }
+
+        walk(graph, a, Flow::Upstream, reached);
+        for(auto* node: reached){
+            upstream.visit(node->ID);
+        }
+    }
+
+    if (source == a)
+        return downstream.visited(b->ID);
+    return upstream.visited(a->ID);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PUZZLE_EDITOR_SELECTION_HEADER
+#define PUZZLE_EDITOR_SELECTION_HEADER
+
+#include "node.h"
+#include "ids.h"
+
+#include <vector>
+
+// Set of selected nodes
+// membership is a flag indexed by node ID so testing it while drawing
+// thousands of nodes is free
+struct Selection {
+    bool contains(Node const* node) const {
+        return flags.get(node->ID) != 0;
+    }
+
+    void add(Node* node){
+        if (!contains(node)){
+            flags.set(node->ID, 1);
+            nodes.push_back(node);
+        }
+    }
+
+    void clear(){
+        for(auto* node: nodes){
+            flags.erase(node->ID);
+        }
+        nodes.clear();
+    }
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    std::size_t size() const {
+        return nodes.size();
+    }
+
+    std::vector<Node*>::const_iterator begin() const { return nodes.begin(); }
+    std::vector<Node*>::const_iterator end()   const { return nodes.end();   }
+
+    std::vector<Node*> nodes;
+
+private:
+    IdMap<std::uint8_t> flags;
+};
+
+#endif
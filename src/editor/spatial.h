@@ -0,0 +1,157 @@
+#ifndef PUZZLE_EDITOR_SPATIAL_HEADER
+#define PUZZLE_EDITOR_SPATIAL_HEADER
+
+#include "traversal.h"
+#include "ids.h"
+
+#include <imgui.h>
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Axis aligned rectangle in canvas coordinates
+struct Box {
+    ImVec2 min;
+    ImVec2 max;
+
+    bool contains(ImVec2 p) const {
+        return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y;
+    }
+
+    bool overlaps(Box const& b) const {
+        return min.x <= b.max.x && b.min.x <= max.x && min.y <= b.max.y && b.min.y <= max.y;
+    }
+};
+
+// Uniform grid of rectangles indexed by ID
+// Cells are only allocated when something is inside them so the canvas
+// can be as large as needed. A rectangle is registered in every cell it overlaps;
+// moving it only touches the grid when it changes cells
+struct SpatialGrid {
+    // Cell size in canvas units, defaults to a foundation (8 x 8 scaled by 10)
+    SpatialGrid(float cell = 80.f):
+        cell(cell)
+    {}
+
+    void insert(std::uint32_t id, Box const& box){
+        boxes.set(id, box);
+        for_each_cell(box, [&](std::uint64_t key){
+            cells[key].push_back(id);
+        });
+    }
+
+    void remove(std::uint32_t id){
+        for_each_cell(boxes.get(id), [&](std::uint64_t key){
+            auto& ids = cells[key];
+
+            for(auto& v: ids){
+                if (v == id){
+                    v = ids.back();
+                    ids.pop_back();
+                    break;
+                }
+            }
+
+            if (ids.empty()){
+                cells.erase(key);
+            }
+        });
+        boxes.erase(id);
+    }
+
+    void update(std::uint32_t id, Box const& box){
+        auto old = boxes.get(id);
+
+        if (cell_range(old) == cell_range(box)){
+            boxes.set(id, box);
+            return;
+        }
+
+        remove(id);
+        insert(id, box);
+    }
+
+    Box bounds(std::uint32_t id) const {
+        return boxes.get(id);
+    }
+
+    // Call fun(id) once for every rectangle overlapping box
+    // the grid must not be modified by fun
+    template<typename Fun>
+    void query(Box const& box, Fun&& fun){
+        seen.reset();
+
+        auto visit = [&](std::vector<std::uint32_t> const& cell_ids){
+            for(auto id: cell_ids){
+                if (seen.visit(id) && boxes.get(id).overlaps(box)){
+                    fun(id);
+                }
+            }
+        };
+
+        // large queries (box selection of the whole factory)
+        // scan the occupied cells instead of the empty ones
+        auto r = cell_range(box);
+        auto area = std::uint64_t(std::int64_t(r.x1) - r.x0 + 1) * std::uint64_t(std::int64_t(r.y1) - r.y0 + 1);
+
+        if (area > cells.size()){
+            for(auto& item: cells){
+                visit(item.second);
+            }
+            return;
+        }
+
+        for_each_cell(box, [&](std::uint64_t key){
+            auto cell_ids = cells.find(key);
+            if (cell_ids != cells.end()){
+                visit(cell_ids->second);
+            }
+        });
+    }
+
+    void clear(){
+        cells.clear();
+        boxes.clear();
+    }
+
+private:
+    struct CellRange {
+        std::int32_t x0, y0, x1, y1;
+
+        bool operator== (CellRange const& r) const {
+            return x0 == r.x0 && y0 == r.y0 && x1 == r.x1 && y1 == r.y1;
+        }
+    };
+
+    std::int32_t coord(float v) const {
+        return std::int32_t(std::floor(v / cell));
+    }
+
+    CellRange cell_range(Box const& box) const {
+        return {coord(box.min.x), coord(box.min.y), coord(box.max.x), coord(box.max.y)};
+    }
+
+    static std::uint64_t key(std::int32_t x, std::int32_t y){
+        return (std::uint64_t(std::uint32_t(x)) << 32) | std::uint32_t(y);
+    }
+
+    template<typename Fun>
+    void for_each_cell(Box const& box, Fun&& fun) const {
+        auto r = cell_range(box);
+
+        for(auto x = r.x0; x <= r.x1; ++x){
+            for(auto y = r.y0; y <= r.y1; ++y){
+                fun(key(x, y));
+            }
+        }
+    }
+
+    float                                                          cell;
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> cells;
+    IdMap<Box>                                                     boxes;
+    VisitedSet                                                     seen;
+};
+
+#endif
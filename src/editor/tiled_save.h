@@ -0,0 +1,81 @@
+#ifndef PUZZLE_EDITOR_TILED_SAVE_HEADER
+#define PUZZLE_EDITOR_TILED_SAVE_HEADER
+
+#include "forest.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Mapped binary save, see binary_save.cpp
+struct SaveFile;
+
+// Binary save loaded one tile at a time
+// Nodes of a save are grouped in square tiles by position, a tile is loaded
+// with the links between its nodes and the links to the tiles already loaded.
+// The editor loads the tiles in view first and streams the others a few per
+// frame, so a large factory can be navigated before it is fully loaded.
+//
+// The forest is cleared, the nodes get the IDs they were saved with.
+// It can be edited while the tiles are loaded but it must not be saved
+// before complete() (the missing tiles would be lost)
+struct TiledSave {
+    TiledSave(Forest& forest, std::string const& path);
+
+    ~TiledSave();
+
+    TiledSave(TiledSave const&) = delete;
+
+    // false if the file is not a binary save or its tiles are corrupted
+    bool valid() const;
+
+    // Load the tiles overlapping the region, they are loaded first
+    // returns the number of tiles loaded
+    std::size_t load(Box const& region);
+
+    // Load up to count tiles, the closest to the last region first
+    std::size_t load_next(std::size_t count);
+
+    void load_all();
+
+    bool complete() const {
+        return remaining == 0;
+    }
+
+    // Number of tiles not loaded yet
+    std::size_t missing_count() const {
+        return remaining;
+    }
+
+    // Rectangles of the tiles not loaded yet (canvas coordinates)
+    std::vector<Box> missing() const;
+
+private:
+    // The tiles cover the nodes and the links of the save, and the links
+    // refer to nodes of the save; the save is not loaded otherwise
+    bool check() const;
+
+    void load_tile(std::uint32_t tile);
+
+    // Tile holding the node record
+    std::uint32_t tile_of(std::uint32_t node) const;
+
+    Box bounds(std::uint32_t tile) const;
+
+    Forest&                   forest;
+    std::unique_ptr<SaveFile> save;
+    float                     tile_size = 1.f;
+    ImVec2                    focus;
+
+    std::vector<bool>         resident;
+    std::size_t               remaining = 0;
+
+    // tile coordinates to tile
+    std::unordered_map<std::uint64_t, std::uint32_t> tile_index;
+
+    // links between two tiles, listed under both (CSR)
+    std::vector<std::uint32_t> crossing_offsets;
+    std::vector<std::uint32_t> crossing;
+};
+
+#endif
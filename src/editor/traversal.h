@@ -0,0 +1,186 @@
+#ifndef PUZZLE_EDITOR_TRAVERSAL_HEADER
+#define PUZZLE_EDITOR_TRAVERSAL_HEADER
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Building blocks for the graph traversals of the Forest
+// Everything here is meant to be kept around and reused between traversals
+// so once the buffers have grown to the size of the graph nothing gets allocated
+
+
+// Double ended queue backed by a ring buffer
+// pop_front makes it a FIFO (BFS) and pop_back a LIFO (DFS)
+// the buffer only grows when it is full, clear() keeps the capacity
+template<typename T>
+struct RingQueue {
+    void clear(){
+        head = 0;
+        count = 0;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    std::size_t size() const {
+        return count;
+    }
+
+    void push_back(T const& v){
+        if (count == data.size()){
+            grow();
+        }
+
+        data[(head + count) & (data.size() - 1)] = v;
+        count += 1;
+    }
+
+    T pop_front(){
+        T v = data[head];
+        head = (head + 1) & (data.size() - 1);
+        count -= 1;
+        return v;
+    }
+
+    T pop_back(){
+        count -= 1;
+        return data[(head + count) & (data.size() - 1)];
+    }
+
+private:
+    // capacity is kept to a power of 2 so we can wrap with a mask
+    void grow(){
+        std::vector<T> larger(std::max<std::size_t>(16, data.size() * 2));
+
+        for(std::size_t i = 0; i < count; ++i){
+            larger[i] = data[(head + i) & (data.size() - 1)];
+        }
+
+        data.swap(larger);
+        head = 0;
+    }
+
+    std::vector<T> data;
+    std::size_t    head  = 0;
+    std::size_t    count = 0;
+};
+
+
+// Array of values that are reset in O(1) by bumping an epoch
+// a slot is only considered set if it was written during the current epoch
+template<typename T>
+struct StampedArray {
+    // Invalidate all the values
+    void reset(){
+        epoch += 1;
+
+        // wrapped around, old stamps could be mistaken for new ones
+        if (epoch == 0){
+            std::fill(stamps.begin(), stamps.end(), 0u);
+            epoch = 1;
+        }
+    }
+
+    bool has(std::size_t id) const {
+        return id < stamps.size() && stamps[id] == epoch;
+    }
+
+    // Returns the value of the slot, default initialized if it was not set this epoch
+    T& operator[] (std::size_t id){
+        reserve(id);
+
+        if (stamps[id] != epoch){
+            stamps[id] = epoch;
+            values[id] = T();
+        }
+        return values[id];
+    }
+
+    void reserve(std::size_t id){
+        if (id >= stamps.size()){
+            auto n = std::max<std::size_t>(id + 1, stamps.size() * 2);
+            stamps.resize(n, 0u);
+            values.resize(n);
+        }
+    }
+
+private:
+    std::vector<std::uint32_t> stamps;
+    std::vector<T>             values;
+    std::uint32_t              epoch = 1;
+};
+
+
+// Set of visited IDs, cleared in O(1) by bumping an epoch
+struct VisitedSet {
+    void reset(){
+        epoch += 1;
+
+        if (epoch == 0){
+            std::fill(stamps.begin(), stamps.end(), 0u);
+            epoch = 1;
+        }
+    }
+
+    bool visited(std::size_t id) const {
+        return id < stamps.size() && stamps[id] == epoch;
+    }
+
+    // Mark the id as visited, returns false if it was already visited
+    bool visit(std::size_t id){
+        if (id >= stamps.size()){
+            stamps.resize(std::max<std::size_t>(id + 1, stamps.size() * 2), 0u);
+        }
+
+        if (stamps[id] == epoch){
+            return false;
+        }
+
+        stamps[id] = epoch;
+        return true;
+    }
+
+private:
+    std::vector<std::uint32_t> stamps;
+    std::uint32_t              epoch = 1;
+};
+
+
+// Which way links are followed during a traversal
+enum class Flow {
+    Downstream,     // from outputs to inputs (roots to leaves)
+    Upstream        // from inputs to outputs (leaves to roots)
+};
+
+// How the next node is picked from the frontier
+enum class Order {
+    BreadthFirst,
+    DepthFirst
+};
+
+// Scratch buffers shared by all the traversals of a forest
+// Traversals are not reentrant: a visitor must not start a new traversal
+// on the same forest
+template<typename T>
+struct GraphWalker {
+    RingQueue<T>                frontier;
+    VisitedSet                  visited;
+    StampedArray<std::uint32_t> degree;
+    bool                        busy = false;
+
+    void begin(){
+        assert(!busy && "Traversals are not reentrant");
+        busy = true;
+        frontier.clear();
+        visited.reset();
+    }
+
+    void end(){
+        busy = false;
+    }
+};
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef PUZZLE_EDITOR_UTILS_HEADER
 #define PUZZLE_EDITOR_UTILS_HEADER
 
+#include <algorithm>
 #include <list>
 #include <string>
+#include <thread>
+#include <vector>
 #include <cmath> // fmodf
 
 #include <SDL2/SDL_keycode.h>
@@ -33,6 +36,44 @@ enum Direction {
     BottomToTop
 };
 
+// Number of chunks to split count elements in, for at most threads threads
+// (0 for one per core). Small ranges are not worth starting a thread for
+inline
+std::size_t parallel_chunks(std::size_t count, unsigned threads = 0){
+    constexpr std::size_t min_chunk = 4096;
+
+    if (threads == 0){
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return std::clamp<std::size_t>(count / min_chunk, 1, threads);
+}
+
+// Call fun(chunk, begin, end) on every chunk of [0, count) concurrently
+// the first chunk is processed on the calling thread
+template<typename Fun>
+void parallel_for(std::size_t count, std::size_t chunks, Fun&& fun){
+    if (chunks <= 1){
+        fun(std::size_t(0), std::size_t(0), count);
+        return;
+    }
+
+    auto size = (count + chunks - 1) / chunks;
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+
+    for(std::size_t k = 1; k < chunks; ++k){
+        workers.emplace_back([&fun, k, size, count](){
+            fun(k, std::min(k * size, count), std::min((k + 1) * size, count));
+        });
+    }
+
+    fun(std::size_t(0), std::size_t(0), std::min(size, count));
+
+    for(auto& worker: workers){
+        worker.join();
+    }
+}
+
 template<typename T>
 struct Iterator{
     T s;
@@ -0,0 +1,512 @@
+#include "world.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+bool World::partition(Forest& forest, int parts, std::string const& directory){
+    clear();
+    parts = std::max(parts, 1);
+
+    // keep the lines together, nodes of a line in creation order
+    std::vector<std::pair<std::uint32_t, Node const*>> order;
+    order.reserve(forest.node_count());
+
+    for(auto& node: forest.iter_nodes()){
+        order.emplace_back(forest.component(&node), &node);
+    }
+
+    std::sort(order.begin(), order.end(), [](auto const& a, auto const& b){
+        if (a.first != b.first)
+            return a.first < b.first;
+        return a.second->ID < b.second->ID;
+    });
+
+    IdMap<std::uint32_t> part_of;
+    auto per_part = (order.size() + std::size_t(parts) - 1) / std::size_t(parts);
+
+    for(std::size_t i = 0; i < order.size(); ++i){
+        part_of.set(order[i].second->ID, std::uint32_t(i / per_part));
+    }
+
+    // every part is written to its own file, the workers load them on their own
+    for(int k = 0; k < parts; ++k){
+        auto path = fmt::format("{}/part_{}.bin", directory, k);
+        auto snapshot = forest.snapshot(0, [&](Node const* node){
+            return part_of.get(node->ID) == std::uint32_t(k);
+        });
+
+        if (!Forest::write_snapshot(*snapshot, path)){
+            warn("Part {} could not be written to {}", k, path);
+            clear();
+            return false;
+        }
+
+        add_save_file(fmt::format("part_{}", k), path);
+    }
+
+    // the parts keep the pin IDs of the forest
+    for(auto& link: forest.iter_links()){
+        auto ps = part_of.get(link.start->parent->ID);
+        auto pe = part_of.get(link.end->parent->ID);
+
+        if (ps == pe)
+            continue;
+
+        auto name = fmt::format("link_{}", link.ID);
+        if (link.start->is_input){
+            connect(name, pe, link.end->ID, ps, link.start->ID);
+        } else {
+            connect(name, ps, link.start->ID, pe, link.end->ID);
+        }
+    }
+
+    return true;
+}
+
+#ifdef __linux__
+namespace {
+
+// Messages are built in memory and sent with a single write
+// reading past the end of a message clears ok instead of reading garbage
+struct Message {
+    std::vector<char> data;
+    std::size_t       pos = 0;
+    bool              ok  = true;
+
+    template<typename T>
+    void write(T const& v){
+        auto size = data.size();
+        data.resize(size + sizeof(T));
+        std::memcpy(data.data() + size, &v, sizeof(T));
+    }
+
+    template<typename T>
+    T read(){
+        T v{};
+        if (!ok || data.size() - pos < sizeof(T)){
+            ok = false;
+            return v;
+        }
+
+        std::memcpy(&v, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    void write_string(std::string const& str){
+        write(std::uint32_t(str.size()));
+        data.insert(data.end(), str.begin(), str.end());
+    }
+
+    std::string read_string(){
+        auto size = read<std::uint32_t>();
+        if (!ok || data.size() - pos < size){
+            ok = false;
+            return {};
+        }
+
+        std::string str(data.data() + pos, size);
+        pos += size;
+        return str;
+    }
+
+    void write_book(ProductionBook const& book){
+        write(std::uint32_t(book.size()));
+
+        for(auto& item: book){
+            write_string(item.first);
+            write(item.second);
+        }
+    }
+
+    // every item takes some bytes, a corrupted count stops at the end of the message
+    bool read_book(ProductionBook& book){
+        book.clear();
+        auto count = read<std::uint32_t>();
+
+        for(std::uint32_t i = 0; i < count && ok; ++i){
+            auto name = read_string();
+            auto stat = read<ItemStat>();
+
+            if (ok){
+                book[name] = stat;
+            }
+        }
+        return ok;
+    }
+
+    void clear(){
+        data.clear();
+        pos = 0;
+        ok = true;
+    }
+};
+
+// Largest message accepted, the production of every node of a save
+constexpr std::uint64_t max_message = std::uint64_t(1) << 32;
+
+bool send_all(int fd, char const* data, std::size_t size){
+    while (size > 0){
+        // a dead peer is reported as an error instead of SIGPIPE
+        auto n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        data += n;
+        size -= std::size_t(n);
+    }
+    return true;
+}
+
+bool recv_all(int fd, char* data, std::size_t size){
+    while (size > 0){
+        auto n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        data += n;
+        size -= std::size_t(n);
+    }
+    return true;
+}
+
+// Messages are prefixed by their size
+bool send(int fd, Message const& msg){
+    auto size = std::uint64_t(msg.data.size());
+    return send_all(fd, reinterpret_cast<char const*>(&size), sizeof(size))
+        && send_all(fd, msg.data.data(), msg.data.size());
+}
+
+bool recv(int fd, Message& msg){
+    std::uint64_t size = 0;
+    msg.clear();
+
+    if (!recv_all(fd, reinterpret_cast<char*>(&size), sizeof(size)) || size > max_message)
+        return false;
+
+    msg.data.resize(size);
+    return recv_all(fd, msg.data.data(), size);
+}
+
+// Setup:   path, port count, (pin ID, side) per port    -> ok
+// Tick:    book per port                                 -> change, book per port
+// Stop:                                                  -> node count, (ID, efficiency, book) per node
+enum Command: std::uint32_t {
+    Setup,
+    Tick,
+    Stop
+};
+
+enum Side: std::uint8_t {
+    Export,
+    Import
+};
+
+// Boundary ports of a save, the side owned by the save
+struct Port {
+    Boundary*       boundary;
+    ProductionBook* book;
+    std::uint32_t   pin;
+    Side            side;
+};
+
+std::vector<Port> ports_of(World& world, std::size_t k){
+    std::vector<Port> ports;
+
+    for(auto& boundary: world.boundaries){
+        if (boundary->from == k){
+            ports.push_back({boundary.get(), &boundary->exported, boundary->out_id, Export});
+        }
+        if (boundary->to == k){
+            ports.push_back({boundary.get(), &boundary->imported, boundary->in_id, Import});
+        }
+    }
+    return ports;
+}
+
+}
+
+int World::run_worker(int fd){
+    Message msg;
+    if (!recv(fd, msg) || msg.read<std::uint32_t>() != Setup){
+        warn("Worker was not set up");
+        return 1;
+    }
+
+    WorldSave save;
+    save.path = msg.read_string();
+    save.forest = std::make_unique<Forest>();
+
+    auto count = msg.read<std::uint32_t>();
+    std::vector<std::pair<std::uint32_t, Side>> pins;
+
+    for(std::uint32_t i = 0; i < count && msg.ok; ++i){
+        auto pin = msg.read<std::uint32_t>();
+        pins.emplace_back(pin, Side(msg.read<std::uint8_t>()));
+    }
+
+    bool ready = msg.ok && save.forest->load_binary(save.path, &save.pins);
+
+    // the worker owns its side of the boundaries
+    std::vector<ProductionBook> books(pins.size());
+    for(std::size_t i = 0; i < pins.size() && ready; ++i){
+        auto* pin = save.pins.get(pins[i].first);
+        ready = pin != nullptr;
+
+        if (ready){
+            save.forest->set_port(pin, &books[i]);
+        }
+    }
+
+    save.simulation = std::make_unique<Simulation>(save.forest.get());
+
+    msg.clear();
+    msg.write(std::uint8_t(ready));
+    if (!send(fd, msg) || !ready){
+        warn("Worker could not load {}", save.path);
+        close(fd);
+        return 1;
+    }
+
+    while (recv(fd, msg)){
+        auto command = msg.read<std::uint32_t>();
+
+        if (command == Stop){
+            // send back the production of every node
+            msg.clear();
+            msg.write(std::uint32_t(save.forest->node_count()));
+            for(auto& node: save.forest->iter_nodes()){
+                msg.write(node.ID);
+                msg.write(node.efficiency);
+                msg.write_book(node.production());
+            }
+            send(fd, msg);
+            close(fd);
+            return 0;
+        }
+
+        for(auto& book: books){
+            msg.read_book(book);
+        }
+
+        if (command != Tick || !msg.ok){
+            warn("Worker received a corrupted message");
+            break;
+        }
+
+        auto change = save.tick();
+
+        msg.clear();
+        msg.write(change);
+        for(auto& book: books){
+            msg.write_book(book);
+        }
+
+        if (!send(fd, msg))
+            break;
+    }
+
+    close(fd);
+    return 1;
+}
+
+int World::simulate_processes(int max_iterations, float tolerance){
+    if (saves.empty() || max_iterations <= 0){
+        return 0;
+    }
+
+    // the workers load the saves from their files, the ones only in memory cannot be shared
+    auto worker = puzzle::binary_path() + "/world_worker";
+    auto in_memory = std::any_of(saves.begin(), saves.end(), [](WorldSave const& save){
+        return save.path.empty();
+    });
+
+    if (in_memory || access(worker.c_str(), X_OK) != 0){
+        warn("World workers are not available, simulating with threads");
+        return simulate(max_iterations, tolerance);
+    }
+
+    std::vector<int>                 fds;
+    std::vector<pid_t>               pids;
+    std::vector<std::vector<Port>>   ports;
+
+    auto stop = [&](){
+        for(auto fd: fds){
+            close(fd);
+        }
+        for(auto pid: pids){
+            waitpid(pid, nullptr, 0);
+        }
+    };
+
+    for(std::size_t k = 0; k < saves.size(); ++k){
+        ports.push_back(ports_of(*this, k));
+
+        // the other sockets are closed by exec
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0){
+            warn("Could not create worker socket: {}", std::strerror(errno));
+            stop();
+            return simulate(max_iterations, tolerance);
+        }
+
+        // only async signal safe calls between fork and exec,
+        // the editor has other threads running
+        auto fd = std::to_string(pair[1]);
+        char* argv[] = {worker.data(), fd.data(), nullptr};
+
+        auto pid = fork();
+        if (pid < 0){
+            warn("Could not fork worker: {}", std::strerror(errno));
+            close(pair[0]);
+            close(pair[1]);
+            stop();
+            return simulate(max_iterations, tolerance);
+        }
+
+        if (pid == 0){
+            fcntl(pair[1], F_SETFD, 0);
+            execv(argv[0], argv);
+            _exit(127);
+        }
+
+        close(pair[1]);
+        fds.push_back(pair[0]);
+        pids.push_back(pid);
+    }
+
+    Message msg;
+    auto failed = [&](std::size_t k){
+        warn("Worker {} ({}) failed", k, saves[k].name);
+        for(auto pid: pids){
+            kill(pid, SIGKILL);
+        }
+        stop();
+        return -1;
+    };
+
+    for(std::size_t k = 0; k < saves.size(); ++k){
+        msg.clear();
+        msg.write(std::uint32_t(Setup));
+        msg.write_string(saves[k].path);
+        msg.write(std::uint32_t(ports[k].size()));
+
+        for(auto& port: ports[k]){
+            msg.write(port.pin);
+            msg.write(std::uint8_t(port.side));
+        }
+
+        if (!send(fds[k], msg))
+            return failed(k);
+    }
+
+    for(std::size_t k = 0; k < saves.size(); ++k){
+        if (!recv(fds[k], msg) || msg.read<std::uint8_t>() != 1)
+            return failed(k);
+    }
+
+    int iterations = max_iterations;
+    bool converged = false;
+
+    for(int i = 0; i < max_iterations; ++i){
+        // start all the workers before waiting for any of them
+        for(std::size_t k = 0; k < saves.size(); ++k){
+            msg.clear();
+            msg.write(std::uint32_t(Tick));
+
+            for(auto& port: ports[k]){
+                msg.write_book(*port.book);
+            }
+
+            if (!send(fds[k], msg))
+                return failed(k);
+        }
+
+        float change = 0;
+        for(std::size_t k = 0; k < saves.size(); ++k){
+            if (!recv(fds[k], msg))
+                return failed(k);
+
+            change = std::max(change, msg.read<float>());
+            for(auto& port: ports[k]){
+                msg.read_book(*port.book);
+            }
+
+            if (!msg.ok)
+                return failed(k);
+        }
+
+        change = std::max(change, exchange());
+        debug("World iteration {}: {}", i, change);
+
+        if (change < tolerance){
+            iterations = i + 1;
+            converged = true;
+            break;
+        }
+    }
+
+    if (!converged){
+        warn("World did not converge after {} iterations", max_iterations);
+    }
+
+    // retrieve the results, into the nodes of the saves loaded here
+    for(std::size_t k = 0; k < saves.size(); ++k){
+        auto& save = saves[k];
+
+        msg.clear();
+        msg.write(std::uint32_t(Stop));
+
+        if (!send(fds[k], msg) || !recv(fds[k], msg))
+            return failed(k);
+
+        save.efficiency.clear();
+        auto count = msg.read<std::uint32_t>();
+        ProductionBook book;
+
+        for(std::uint32_t i = 0; i < count && msg.ok; ++i){
+            auto id = msg.read<std::uint32_t>();
+            auto efficiency = msg.read<float>();
+            msg.read_book(book);
+
+            auto* node = save.forest != nullptr ? save.forest->find_node(id) : nullptr;
+            if (node != nullptr){
+                node->efficiency = efficiency;
+                node->logic->production = book;
+            } else if (save.forest == nullptr){
+                save.efficiency[id] = efficiency;
+            }
+        }
+
+        if (!msg.ok)
+            return failed(k);
+    }
+
+    stop();
+    return iterations;
+}
+
+#else
+
+int World::run_worker(int){
+    return 1;
+}
+
+int World::simulate_processes(int max_iterations, float tolerance){
+    return simulate(max_iterations, tolerance);
+}
+
+#endif
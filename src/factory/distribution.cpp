@@ -0,0 +1,162 @@
+#include "simulation.h"
+#include "editor/forest.h"
+
+#include <algorithm>
+
+void DistributionLogic::fuse(std::vector<Member> const& members){
+    head = members[0].relay;
+    inputs = members[0].inputs;
+    outputs.clear();
+
+    // fraction of the flow of the head going through each channel of the chain
+    std::unordered_map<ProductionBook*, float> flow;
+    for(auto i = 1u; i < members.size(); ++i){
+        flow[members[i].inputs[0]] = 0.f;
+    }
+
+    for(auto i = 0u; i < members.size(); ++i){
+        auto& member = members[i];
+
+        // a member without outputs keeps what it receives, nothing goes through it
+        if (member.outputs.empty())
+            continue;
+
+        // members are ticked after the member feeding them
+        auto through = i == 0 ? 1.f : flow[member.inputs[0]];
+        auto share = through / float(member.outputs.size());
+
+        for(auto* channel: member.outputs){
+            auto internal = flow.find(channel);
+
+            if (internal != flow.end()){
+                internal->second = share;
+            } else {
+                outputs.push_back({channel, share});
+            }
+        }
+    }
+}
+
+// RelayLogic::tick of the head with the split of the whole chain
+void DistributionLogic::tick(){
+    head->receive(inputs);
+
+    if (outputs.empty()){
+        head->clear_outputs();
+        return;
+    }
+
+    for(auto& item: head->production){
+        auto received = item.second.received;
+        item.second.consumed = 0;
+
+        for(auto& output: outputs){
+            auto& out = (*output.channel)[item.first];
+            auto can_be_send = std::max(received * output.fraction - out.produced, 0.f);
+
+            out.produced += can_be_send;
+            item.second.received -= can_be_send;
+            item.second.consumed += can_be_send;
+        }
+    }
+}
+
+void Simulation::fuse_relays(std::vector<Node*> const& order){
+    fused.clear();
+
+    // position in tick order + 1, 0 for nodes that are not ticked
+    IdMap<std::uint32_t> position;
+    for(auto i = 0u; i < order.size(); ++i){
+        position.set(order[i]->ID, i + 1);
+    }
+
+    struct Group {
+        DistributionLogic*                      logic;
+        std::uint32_t                           head;    // position of the head
+        std::size_t                             slot;    // entry in the schedule
+        std::vector<DistributionLogic::Member>  members;
+    };
+
+    std::vector<Group>  groups;
+    IdMap<std::uint32_t> group_of;  // group index + 1
+
+    // index of the group node can join, groups.size() if none
+    auto joinable = [&](Node* node, std::uint32_t pos) -> std::size_t {
+        NodeLink* input = nullptr;
+
+        for(auto* pin: node->input_pins()){
+            auto* link = forest->find_link(pin);
+            if (link == nullptr && forest->find_port(pin) == nullptr)
+                continue;
+
+            if (input != nullptr || link == nullptr)
+                return groups.size();
+            input = link;
+        }
+
+        if (input == nullptr)
+            return groups.size();
+
+        auto g = group_of.get(get_next(input, node)->ID);
+        if (g == 0)
+            return groups.size();
+
+        // the member now ticks with the head, nothing ticking
+        // in between can touch its outputs
+        for(auto* pin: node->output_pins()){
+            auto* link = forest->find_link(pin);
+            if (link == nullptr)
+                continue;
+
+            auto next = position.get(get_next(link, node)->ID);
+            if (next != 0 && next >= groups[g - 1].head && next < pos)
+                return groups.size();
+        }
+
+        return g - 1;
+    };
+
+    for(auto i = 0u; i < order.size(); ++i){
+        auto* node = order[i];
+
+        // programmed splitters route items by themselves
+        if (!node->is_relay() || static_cast<RelayLogic*>(node->logic.get())->programmed){
+            _schedule.push_back(node->logic.get());
+            continue;
+        }
+
+        auto g = joinable(node, i + 1);
+
+        if (g == groups.size()){
+            auto logic = std::make_unique<DistributionLogic>(forest);
+            groups.push_back({logic.get(), i + 1, _schedule.size(), {}});
+            _schedule.push_back(logic.get());
+            fused.push_back(std::move(logic));
+        }
+
+        auto* relay = static_cast<RelayLogic*>(node->logic.get());
+        groups[g].members.push_back({
+            relay,
+            relay->channels(node->input_pins()),
+            relay->channels(node->output_pins())
+        });
+        group_of.set(node->ID, std::uint32_t(g + 1));
+    }
+
+    // a relay on its own does not need to be fused
+    std::size_t relays = 0;
+    for(auto& group: groups){
+        if (group.members.size() == 1){
+            _schedule[group.slot] = group.members[0].relay;
+        } else {
+            group.logic->fuse(group.members);
+            relays += group.members.size();
+        }
+    }
+
+    fused.erase(std::remove_if(fused.begin(), fused.end(), [](auto const& logic){
+        return static_cast<DistributionLogic*>(logic.get())->head == nullptr;
+    }), fused.end());
+
+    debug("Fused {} relays into {} distribution nodes", relays, fused.size());
+}
@@ -16,16 +16,16 @@ void ManufacturerLogic::fetch_inputs(Recipe* recipe) {
     for(auto& ingredient: recipe->inputs){
         auto& prod = production[ingredient.name];
 
-        for(auto& in_pin: self->input_pins){
-            auto in_link = find_link(in_pin);
+        for(auto* in_pin: self->input_pins()){
+            auto in_link = find_channel(in_pin);
             if (!in_link)
                 continue;
 
             if (in_pin->compatible(ingredient)) {
                 auto can_be_received = std::max(ingredient.speed - prod.received, 0.f);
-                auto received = std::min(can_be_received, in_link->production[ingredient.name].produced);
+                auto received = std::min(can_be_received, (*in_link)[ingredient.name].produced);
 
-                in_link->production[ingredient.name].produced -= received;
+                (*in_link)[ingredient.name].produced -= received;
                 prod.received += received;
             }
         }
@@ -88,23 +88,23 @@ void ManufacturerLogic::dispatch_outputs(Recipe* recipe) {
         auto& prod = production[ingredient.name];
         prod.limit_produced = ingredient.speed;
 
-        for(auto& out_pin: self->output_pins){
-            auto out_link = find_link(out_pin);
+        for(auto* out_pin: self->output_pins()){
+            auto out_link = find_channel(out_pin);
 
             if (!out_link)
                 continue;
 
             if (out_pin->compatible(ingredient)) {
                 // the amount of resources remaining since last tick
-                auto remaining = out_link->production[ingredient.name].produced;
+                auto remaining = (*out_link)[ingredient.name].produced;
                 auto can_be_send = std::max(prod.produced - remaining, 0.f);
 
                 if (can_be_send >= 0.f){
                     debug("max({}- {}, {})", prod.produced, remaining, 0.f);
                 }
 
-                out_link->production[ingredient.name].produced += can_be_send;
-                out_link->production[ingredient.name].limit_produced = prod.limit_produced;
+                (*out_link)[ingredient.name].produced += can_be_send;
+                (*out_link)[ingredient.name].limit_produced = prod.limit_produced;
 
                 prod.produced -= can_be_send;
                 prod.consumed = can_be_send;
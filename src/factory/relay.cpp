@@ -1,30 +1,140 @@
 #include "simulation.h"
 #include "editor/forest.h"
 
+#include <array>
+#include <bit>
+
 RelayLogic::RelayLogic(Forest* f, Node* s):
     SimulationLogic(f), self(s)
 {
     if (self->is_input_pipe(0)){
         capacity = 300.f;
     }
+
+    compile_rules(forest->find_rules(self));
 }
 
-void RelayLogic::fetch_inputs(){
-    // Gather all the resources we are receiving
-    for(auto& in_pin: self->input_pins){
-        auto in_link = find_link(in_pin);
-        if (!in_link)
-            continue;
+void RelayLogic::compile_rules(SplitterRules const* rules){
+    routes.clear();
+    item_routes.clear();
+    any_outputs = 0;
+    overflow_outputs = 0;
+    programmed = rules != nullptr && !rules->empty();
+
+    if (!programmed){
+        return;
+    }
 
-        auto& link_prod = in_link->production;
+    auto& rsc = Resources::instance();
+    std::vector<std::uint8_t> items(rsc.items.size(), 0);
+
+    for(auto i = 0u; i < rules->size() && i < NodePins::capacity; ++i){
+        auto& rule = (*rules)[i];
+        auto bit = std::uint8_t(1u << i);
+
+        switch (rule.kind){
+        case SplitterRule::Any:
+            any_outputs |= bit;
+            break;
+
+        case SplitterRule::Overflow:
+            overflow_outputs |= bit;
+            break;
+
+        case SplitterRule::Item: {
+            auto id = rsc.find_item(rule.item);
+            if (id < 0){
+                warn("Splitter {} filters unknown item {}", self->ID, rule.item);
+                break;
+            }
+            items[std::size_t(id)] |= bit;
+            break;
+        }
 
-        for(auto& item: link_prod){
-            auto& prod = production[item.first];
+        case SplitterRule::None:
+            break;
+        }
+    }
+
+    routes.resize(items.size());
+    for(auto i = 0u; i < items.size(); ++i){
+        routes[i] = items[i] != 0 ? items[i] : any_outputs;
+    }
+}
+
+void RelayLogic::route_outputs(){
+    std::array<ProductionBook*, NodePins::capacity> outputs = {};
+    std::uint8_t connected = 0;
 
-            float remaining = prod.received;
+    auto pins = self->output_pins();
+    for(auto i = 0u; i < pins.size(); ++i){
+        outputs[i] = find_channel(pins[i]);
+
+        if (outputs[i] != nullptr){
+            connected |= std::uint8_t(1u << i);
+        }
+    }
+
+    if (connected == 0){
+        clear_outputs();
+        return;
+    }
+
+    if (item_routes.size() != production.size()){
+        auto& rsc = Resources::instance();
+        item_routes.clear();
+        item_routes.reserve(production.size());
+
+        for(auto& item: production){
+            auto id = rsc.find_item(item.first);
+            auto mask = id >= 0 && std::size_t(id) < routes.size() ? routes[std::size_t(id)] : any_outputs;
+            item_routes.push_back({&item.first, &item.second, mask});
+        }
+    }
+
+    // split evenly what is available across the outputs
+    auto send = [&outputs](std::string const& name, ItemStat& prod, std::uint8_t mask){
+        if (mask == 0)
+            return;
+
+        auto share = prod.received / float(std::popcount(unsigned(mask)));
+
+        for(; mask != 0; mask &= std::uint8_t(mask - 1)){
+            auto& out = (*outputs[std::size_t(std::countr_zero(unsigned(mask)))])[name];
+            auto can_be_send = std::max(share - out.produced, 0.f);
+
+            out.produced += can_be_send;
+            prod.received -= can_be_send;
+            prod.consumed += can_be_send;
+        }
+    };
+
+    for(auto& route: item_routes){
+        route.stat->consumed = 0;
+        send(*route.name, *route.stat, route.mask & connected);
+        send(*route.name, *route.stat, overflow_outputs & connected);
+    }
+}
+
+std::vector<ProductionBook*> const& RelayLogic::channels(PinSet pins){
+    scratch.clear();
+
+    for(auto* pin: pins){
+        if (auto* channel = find_channel(pin)){
+            scratch.push_back(channel);
+        }
+    }
+    return scratch;
+}
+
+void RelayLogic::receive(std::vector<ProductionBook*> const& inputs){
+    // Gather all the resources we are receiving
+    for(auto* channel: inputs){
+        for(auto& item: *channel){
+            auto& prod = production[item.first];
 
             // Here use belt speed instead
-            auto can_be_received = std::max(capacity - remaining, 0.f);
+            auto can_be_received = std::max(float(capacity) - prod.received, 0.f);
             can_be_received = std::min(can_be_received, item.second.produced);
             item.second.produced -= can_be_received;
 
@@ -35,6 +145,29 @@ void RelayLogic::fetch_inputs(){
     }
 }
 
+void RelayLogic::split(std::vector<ProductionBook*> const& outputs){
+    auto ways = float(outputs.size());
+
+    // items are independent, the share of an item is computed
+    // before sending it to every output
+    for(auto& item: production){
+        auto share = item.second.received / ways;
+        item.second.consumed = 0;
+
+        for(auto* channel: outputs){
+            auto& out = (*channel)[item.first];
+            auto can_be_send = std::max(share - out.produced, 0.f);
+
+            out.produced += can_be_send;
+            item.second.received -= can_be_send;
+            item.second.consumed += can_be_send;
+        }
+    }
+}
+
+void RelayLogic::fetch_inputs(){
+    receive(channels(self->input_pins()));
+}
 
 void RelayLogic::clear_outputs(){
     for(auto& prod: production){
@@ -44,51 +177,17 @@ void RelayLogic::clear_outputs(){
 }
 
 void RelayLogic::dispatch_outputs(){
-    bool is_merger = self->output_pins.size() == 1;
-
-    // Split all the resources accross
-    std::vector<NodeLink*> links;
-    links.reserve(3);
-
-    for(auto& out_pin: self->output_pins){
-        auto out_link = find_link(out_pin);
-        if (!out_link)
-            continue;
-
-        links.push_back(out_link);
-    }
-
-    if (links.size() == 0){
-        clear_outputs();
+    if (programmed){
+        route_outputs();
         return;
     }
 
-    if (is_merger){
-        debug("# Merger {}", self->ID);
-    } else {
-        debug("# Splitter {}", self->ID);
-    }
-
-    ProductionBook available;
-    for(auto& item: production){
-        available[item.first].received = item.second.received / float(links.size());
-        item.second.consumed = 0;
-    }
+    auto& outputs = channels(self->output_pins());
 
-    for(auto& link: links){
-        for(auto& item: production){
-            auto remaining = link->production[item.first].produced;
-
-            debug("    {}: {} {}", item.first, available[item.first].received, remaining);
-            auto can_be_send = std::max(available[item.first].received - remaining, 0.f);
-
-            link->production[item.first].produced += can_be_send;
-            item.second.received -= can_be_send;
-            item.second.consumed += can_be_send;
-
-            debug("    {} {} {} | {}",
-                  item.first, item.second.received, item.second.consumed, link->production[item.first].produced);
-        }
+    if (outputs.empty()){
+        clear_outputs();
+    } else {
+        split(outputs);
     }
 }
 
@@ -13,6 +13,14 @@ NodeLink* SimulationLogic::find_link(Pin* pin) {
     return forest->find_link(pin);
 }
 
+ProductionBook* SimulationLogic::find_channel(Pin const* pin) {
+    auto* link = forest->find_link(pin);
+    if (link != nullptr){
+        return &link->production;
+    }
+    return forest->find_port(pin);
+}
+
 
 SimualtionStep fetch_logic(Forest* f, Node* self){
     if (self->is_relay()){
@@ -32,18 +40,57 @@ SimualtionStep fetch_logic(Forest* f, NodeLink* self){
 
 
 
+void Simulation::compile(){
+    std::vector<Node*> order;
+    order.reserve(std::size_t(forest->node_count()));
+    forest->traverse([&order](Node* n){ order.push_back(n); });
+
+    // allocate the logic one after the other in tick order, the old logic
+    // is released after so its memory is not reused in the middle of the new one
+    std::vector<SimualtionStep> old;
+    old.reserve(order.size());
+
+    for(auto* node: order){
+        auto logic = fetch_logic(forest, node);
+        logic->production = std::move(node->logic->production);
+
+        old.push_back(std::move(node->logic));
+        node->logic = std::move(logic);
+    }
+
+    _schedule.clear();
+    _schedule.reserve(order.size());
+    fuse_relays(order);
+
+    compiled_revision = forest->revision();
+}
+
 void Simulation::compute_production(){
     static int stop = 0;
     static int steps = 0;
 
+    if (paused()){
+        return;
+    }
+
+    if (compiled_revision != forest->revision()){
+        compile();
+    }
+
+    auto tick = [this](){
+        for(auto* logic: _schedule){
+            logic->tick();
+        }
+    };
+
     if (stop == 0){
-        forest->traverse([](Node* n){ n->logic->tick(); });
+        tick();
         return;
     }
 
     // for debugging. if stops is set the simulation stops after a few steps
     for(; steps < stop; steps++){
-        forest->traverse([](Node* n){ n->logic->tick(); });
+        tick();
     }
 }
 
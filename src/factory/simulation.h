@@ -1,8 +1,11 @@
 #ifndef PUZZLE_SIMULATION_SIM_HEADER
 #define PUZZLE_SIMULATION_SIM_HEADER
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <spdlog/fmt/bundled/format.h>
 
@@ -58,6 +61,27 @@ struct ItemStat{
 
 
 class Building;
+struct PinSet;
+
+// Filter of an output of a programmable splitter
+//  Item    : only the item
+//  Any     : items that are not sent to an Item output
+//  Overflow: what the other outputs could not take
+//  None    : nothing
+struct SplitterRule {
+    enum Kind: std::uint8_t {
+        Any,
+        Item,
+        Overflow,
+        None
+    };
+
+    Kind        kind = Any;
+    std::string item;
+};
+
+// One rule per output pin
+using SplitterRules = std::vector<SplitterRule>;
 
 struct Engery{
     float consumed = 0;
@@ -74,6 +98,7 @@ class Node;
 class Forest;
 class Recipe;
 class Pin;
+struct SimulationLogic;
 // Using strategy pattern to define how each building behave in the simulation
 
 
@@ -85,6 +110,29 @@ struct Simulation{
 
     void compute_production();
 
+    // Compute the tick order (breadth first from the roots, so producers
+    // are next to their consumers) and reallocate the node logic in that
+    // order so a tick walks memory forward instead of jumping around.
+    // Chains of relays are ticked as a single distribution node.
+    // Done automatically when the forest is modified
+    void compile();
+
+    // Logic of the nodes in tick order
+    std::vector<SimulationLogic*> const& schedule() const {
+        return _schedule;
+    }
+
+    // Regions of the forest that are not loaded yet (tiled saves)
+    // production lines are cut at the missing regions and every region loaded
+    // would recompile the schedule, the simulation is paused until they are all in
+    void set_missing_regions(std::size_t count){
+        missing_regions = count;
+    }
+
+    bool paused() const {
+        return missing_regions > 0;
+    }
+
     ProductionBook production_statement();
 
     Engery compute_electricity();
@@ -92,6 +140,15 @@ struct Simulation{
     ProductionBook raw_materials();
 
     ProductionBook top_items();
+
+private:
+    // Replace chains of relays by distribution nodes in the schedule
+    void fuse_relays(std::vector<Node*> const& order);
+
+    std::vector<SimulationLogic*> _schedule;
+    std::vector<std::unique_ptr<SimulationLogic>> fused;
+    std::uint64_t                 compiled_revision = ~0ull;
+    std::size_t                   missing_regions = 0;
 };
 
 
@@ -112,6 +169,10 @@ struct SimulationLogic{
 
     NodeLink* find_link(Pin* pin);
 
+    // Items flowing through the pin, the production of its link
+    // or of the port it is bound to, nullptr if the pin is not connected
+    ProductionBook* find_channel(Pin const* pin);
+
     virtual void reset(){
         production.clear();
     }
@@ -146,15 +207,55 @@ struct RelayLogic: public SimulationLogic{
     // FIXME: make this configurable
     int capacity = 780.f;
 
+    // Compiled splitter rules, outputs an item can be sent to (bit i for the i-th output)
+    // indexed by item ID, items without ID go to any_outputs
+    std::vector<std::uint8_t> routes;
+    std::uint8_t              any_outputs      = 0;
+    std::uint8_t              overflow_outputs = 0;
+    bool                      programmed       = false;
+
     RelayLogic(Forest* f, Node* s);
 
     void tick() override;
 
+    void reset() override {
+        production.clear();
+        item_routes.clear();
+    }
+
     virtual void fetch_inputs();
 
     virtual void dispatch_outputs();
 
     void clear_outputs();
+
+    // Take what the input channels hold, up to capacity
+    void receive(std::vector<ProductionBook*> const& inputs);
+
+    // Split the production evenly across the output channels (not empty)
+    void split(std::vector<ProductionBook*> const& outputs);
+
+    // Build the routing table, nullptr or no rules for an even split
+    void compile_rules(SplitterRules const* rules);
+
+    // dispatch_outputs of a programmed splitter
+    void route_outputs();
+
+    // Connected channels of the pins, valid until the next call
+    std::vector<ProductionBook*> const& channels(PinSet pins);
+
+private:
+    std::vector<ProductionBook*> scratch;
+
+    // Outputs of each item of the production, resolved when an item shows up
+    // instead of on every tick. Entries of the book stay valid until a reset
+    // and the book only grows in between
+    struct ItemRoute {
+        std::string const* name;
+        ItemStat*          stat;
+        std::uint8_t       mask;
+    };
+    std::vector<ItemRoute> item_routes;
 };
 
 // Store any items for later
@@ -180,6 +281,39 @@ struct LinkLogic: public SimulationLogic{
     void tick() override;
 };
 
+// Chain of relays (mergers, splitters, junctions) ticked as a single n-way node
+// the head is fed by the rest of the graph, every other member is only fed by
+// another member. The head receives from the inputs of the chain and what it
+// received is split in one pass to the outputs leaving the chain, each one
+// getting the fraction the even splits along the chain would send it.
+// The links inside the chain and the members after the head are not ticked,
+// the book of the head holds the flow of the whole chain
+struct DistributionLogic: public SimulationLogic{
+    struct Member {
+        RelayLogic*                  relay;
+        std::vector<ProductionBook*> inputs;
+        std::vector<ProductionBook*> outputs;
+    };
+
+    struct Output {
+        ProductionBook* channel;
+        float           fraction;   // of what the head received
+    };
+
+    RelayLogic*                  head = nullptr;
+    std::vector<ProductionBook*> inputs;
+    std::vector<Output>          outputs;
+
+    DistributionLogic(Forest* f):
+        SimulationLogic(f)
+    {}
+
+    // Resolve the split fractions, members in tick order, head first
+    void fuse(std::vector<Member> const& members);
+
+    void tick() override;
+};
+
 using SimualtionStep = std::unique_ptr<SimulationLogic>;
 
 SimualtionStep fetch_logic(Forest* f, Node* self);
@@ -0,0 +1,311 @@
+#include "world.h"
+
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <filesystem>
+#include <thread>
+
+float WorldSave::tick(){
+    simulation->compute_production();
+
+    float change = 0;
+    std::size_t i = 0;
+
+    for(auto& node: forest->iter_nodes()){
+        float total = 0;
+        for(auto& item: node.production()){
+            total += item.second.produced + item.second.received;
+        }
+
+        if (i == state.size()){
+            state.push_back(0);
+        }
+
+        change = std::max(change, std::abs(total - state[i]));
+        state[i] = total;
+        i += 1;
+    }
+
+    state.resize(i);
+    return change;
+}
+
+std::size_t World::find_save(std::string const& name) const {
+    for(auto i = 0u; i < saves.size(); ++i){
+        if (saves[i].name == name)
+            return i;
+    }
+    return saves.size();
+}
+
+std::size_t World::add_save(std::string const& name){
+    auto& save = saves.emplace_back();
+    save.name = name;
+    save.forest = std::make_unique<Forest>();
+    save.simulation = std::make_unique<Simulation>(save.forest.get());
+    return saves.size() - 1;
+}
+
+std::size_t World::add_save_file(std::string const& name, std::string const& path){
+    auto& save = saves.emplace_back();
+    save.name = name;
+    save.path = path;
+    return saves.size() - 1;
+}
+
+bool World::load_save(std::size_t k){
+    auto& save = saves[k];
+    if (save.forest != nullptr)
+        return true;
+
+    auto forest = std::make_unique<Forest>();
+    if (!forest->load_binary(save.path, &save.pins)){
+        warn("Save {} could not be loaded from {}", save.name, save.path);
+        save.pins.clear();
+        return false;
+    }
+
+    // bind the boundaries of the save to the loaded pins
+    for(auto& boundary: boundaries){
+        if (boundary->from == k){
+            boundary->out = save.pins.get(boundary->out_id);
+        }
+        if (boundary->to == k){
+            boundary->in = save.pins.get(boundary->in_id);
+        }
+
+        if ((boundary->from == k && boundary->out == nullptr) || (boundary->to == k && boundary->in == nullptr)){
+            warn("Boundary {} has no pin in save {}", boundary->name, save.name);
+            save.pins.clear();
+            return false;
+        }
+    }
+
+    // boundaries are heap allocated so the ports stay valid
+    for(auto& boundary: boundaries){
+        if (boundary->from == k){
+            forest->set_port(boundary->out, &boundary->exported);
+        }
+        if (boundary->to == k){
+            forest->set_port(boundary->in, &boundary->imported);
+        }
+    }
+
+    save.forest = std::move(forest);
+    save.simulation = std::make_unique<Simulation>(save.forest.get());
+    save.efficiency.clear();
+    return true;
+}
+
+Boundary* World::connect(std::string const& name, std::size_t from, Pin const* out, std::size_t to, Pin const* in){
+    if (from >= saves.size() || to >= saves.size() || out == nullptr || in == nullptr
+        || saves[from].forest == nullptr || saves[to].forest == nullptr){
+        warn("Boundary {} is not connected", name);
+        return nullptr;
+    }
+
+    auto& boundary = boundaries.emplace_back(std::make_unique<Boundary>());
+    boundary->name   = name;
+    boundary->from   = from;
+    boundary->to     = to;
+    boundary->out_id = out->ID;
+    boundary->in_id  = in->ID;
+    boundary->out    = out;
+    boundary->in     = in;
+
+    // boundaries are heap allocated so the ports stay valid
+    saves[from].forest->set_port(out, &boundary->exported);
+    saves[to].forest->set_port(in, &boundary->imported);
+    return boundary.get();
+}
+
+Boundary* World::connect(std::string const& name, std::size_t from, std::uint32_t out, std::size_t to, std::uint32_t in){
+    if (from >= saves.size() || to >= saves.size() || out == 0 || in == 0){
+        warn("Boundary {} is not connected", name);
+        return nullptr;
+    }
+
+    // a loaded save resolves the pins through the IDs of its file,
+    // the others bind them when they are loaded
+    Pin const* out_pin = nullptr;
+    Pin const* in_pin  = nullptr;
+
+    if (saves[from].forest != nullptr && (out_pin = saves[from].pins.get(out)) == nullptr){
+        warn("Boundary {} is not connected", name);
+        return nullptr;
+    }
+    if (saves[to].forest != nullptr && (in_pin = saves[to].pins.get(in)) == nullptr){
+        warn("Boundary {} is not connected", name);
+        return nullptr;
+    }
+
+    auto& boundary = boundaries.emplace_back(std::make_unique<Boundary>());
+    boundary->name   = name;
+    boundary->from   = from;
+    boundary->to     = to;
+    boundary->out_id = out;
+    boundary->in_id  = in;
+    boundary->out    = out_pin;
+    boundary->in     = in_pin;
+
+    if (out_pin != nullptr){
+        saves[from].forest->set_port(out_pin, &boundary->exported);
+    }
+    if (in_pin != nullptr){
+        saves[to].forest->set_port(in_pin, &boundary->imported);
+    }
+    return boundary.get();
+}
+
+bool World::load(std::string const& name){
+    auto path = puzzle::binary_path() + "/saves/" + name + ".world.json";
+    std::ifstream world_file(path, std::ios::in | std::ios::binary);
+
+    if (!world_file){
+        warn("File was not found:{} ", path);
+        return false;
+    }
+
+    clear();
+
+    json world;
+    world_file >> world;
+
+    for(auto& save_name: world.at("saves")){
+        auto save = save_name.get<std::string>();
+        auto file = puzzle::binary_path() + "/saves/" + save;
+
+        if (!std::filesystem::exists(file + ".bin") && !std::filesystem::exists(file + ".json")){
+            warn("Save {} of world {} was not found", save, name);
+            clear();
+            return false;
+        }
+
+        // binary saves are loaded when simulated so a worker process can open the file itself,
+        // JSON saves only exist in memory once imported
+        if (std::filesystem::exists(file + ".bin")){
+            add_save_file(save, file + ".bin");
+        } else {
+            auto& ws = saves[add_save(save)];
+            ws.forest->load(save, false, &ws.pins);
+        }
+    }
+
+    if (world.contains("links")){
+        for(auto& jlink: world.at("links")){
+            auto& out = jlink.at("export");
+            auto& in  = jlink.at("import");
+
+            connect(jlink.value("name", ""),
+                    find_save(out.at("save").get<std::string>()), out.at("pin").get<std::uint32_t>(),
+                    find_save(in.at("save").get<std::string>()),  in.at("pin").get<std::uint32_t>());
+        }
+    }
+
+    return true;
+}
+
+float World::exchange(){
+    float change = 0;
+
+    for(auto& boundary: boundaries){
+        ProductionBook transit;
+
+        for(auto* book: {&boundary->exported, &boundary->imported, &boundary->transit}){
+            for(auto& item: *book){
+                transit[item.first];
+            }
+        }
+
+        // both sides started from the items in transit:
+        // the exporter added the items it sent, the importer removed the items it received
+        for(auto& item: transit){
+            auto& old = boundary->transit[item.first];
+            auto& exported = boundary->exported[item.first];
+            auto sent = exported.produced - std::max(old.produced - old.received, 0.f);
+            auto received = old.produced - boundary->imported[item.first].produced;
+
+            item.second.produced = std::max(old.produced + sent - received, 0.f);
+            item.second.limit_produced = exported.limit_produced;
+
+            // flow going through the boundary
+            item.second.received = received;
+
+            change = std::max(change, std::abs(item.second.produced - old.produced));
+            change = std::max(change, std::abs(item.second.received - old.received));
+        }
+
+        boundary->transit  = transit;
+        boundary->imported = transit;
+        boundary->exported = transit;
+
+        // the importer only sees what the exporter sends at the next exchange,
+        // the exporter assumes the importer keeps receiving at the same rate
+        // otherwise both sides take turns and the flow never settles
+        for(auto& item: boundary->exported){
+            item.second.produced = std::max(item.second.produced - item.second.received, 0.f);
+        }
+    }
+
+    return change;
+}
+
+int World::simulate(int max_iterations, float tolerance){
+    if (saves.empty() || max_iterations <= 0){
+        return 0;
+    }
+
+    for(auto k = 0u; k < saves.size(); ++k){
+        if (!load_save(k))
+            return -1;
+    }
+
+    std::vector<float> changes(saves.size());
+    int  iteration = 0;
+    bool converged = false;
+    bool done      = false;
+
+    // run by the last worker to finish an iteration, the others wait for it
+    auto step = [&]() noexcept {
+        auto change = exchange();
+        for(auto c: changes){
+            change = std::max(change, c);
+        }
+        debug("World iteration {}: {}", iteration, change);
+
+        iteration += 1;
+        converged = change < tolerance;
+        done = converged || iteration == max_iterations;
+    };
+
+    std::barrier sync(std::ptrdiff_t(saves.size()), step);
+
+    // one worker per save for the whole simulation,
+    // saves only share the boundaries, which are not touched until the exchange
+    std::vector<std::thread> workers;
+    workers.reserve(saves.size());
+
+    for(auto k = 0u; k < saves.size(); ++k){
+        workers.emplace_back([this, &changes, &sync, &done, k](){
+            while (!done){
+                changes[k] = saves[k].tick();
+                sync.arrive_and_wait();
+            }
+        });
+    }
+
+    for(auto& worker: workers){
+        worker.join();
+    }
+
+    if (!converged){
+        warn("World did not converge after {} iterations", max_iterations);
+    }
+    return iteration;
+}
+
+void World::clear(){
+    boundaries.clear();
+    saves.clear();
+}
@@ -0,0 +1,121 @@
+#ifndef PUZZLE_SIMULATION_WORLD_HEADER
+#define PUZZLE_SIMULATION_WORLD_HEADER
+
+#include "simulation.h"
+#include "editor/forest.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A save simulated as part of a world
+struct WorldSave {
+    std::string                 name;
+    std::string                 path;       // binary save file, empty if the save only exists in memory
+    std::unique_ptr<Forest>     forest;     // nullptr until loaded, see World::load_save
+    std::unique_ptr<Simulation> simulation;
+    PinRemap                    pins;       // pin IDs of the save file to loaded pins
+
+    // Production of every node after the last iteration, used to detect convergence
+    std::vector<float>          state;
+
+    // Efficiency of the nodes (by ID) computed by a worker process
+    // for a save that is not loaded, see World::simulate_processes
+    std::unordered_map<std::uint32_t, float> efficiency;
+
+    // Run one iteration, returns the largest change of the production of a node
+    float tick();
+};
+
+// Named link between an export pin of a save and an import pin of another
+// (trains, trucks, drones).
+// Both saves are simulated concurrently, each one works on its own copy of the
+// items in transit; the copies are reconciled between iterations
+struct Boundary {
+    std::string    name;
+    std::size_t    from = 0;            // exporting save
+    std::size_t    to   = 0;            // importing save
+    std::uint32_t  out_id = 0;          // pin IDs in the save files (in the forest for a save only in memory)
+    std::uint32_t  in_id  = 0;
+    Pin const*     out  = nullptr;      // set while the save is loaded
+    Pin const*     in   = nullptr;
+
+    ProductionBook exported;            // port of the export pin
+    ProductionBook imported;            // port of the import pin
+    ProductionBook transit;             // items in transit after the last exchange (produced)
+                                        // and received by the importer during the last iteration (received)
+};
+
+// Group of saves simulated together
+//
+// saves/<name>.world.json
+//  {
+//      "saves": ["iron_outpost", "main_base"],
+//      "links": [
+//          {
+//              "name": "iron train",
+//              "export": {"save": "iron_outpost", "pin": 12},
+//              "import": {"save": "main_base", "pin": 140}
+//          }
+//      ]
+//  }
+//
+// pins are referred to by the ID they have in their save file
+struct World {
+    std::vector<WorldSave>                 saves;
+    std::vector<std::unique_ptr<Boundary>> boundaries;
+
+    // Binary saves are added with their file and loaded when simulated,
+    // JSON saves are imported right away and can only be simulated with threads
+    bool load(std::string const& name);
+
+    // Add an empty save, returns its index
+    std::size_t add_save(std::string const& name);
+
+    // Add a binary save without loading it, returns its index
+    std::size_t add_save_file(std::string const& name, std::string const& path);
+
+    // Load a save added by add_save_file and bind the pins of its boundaries
+    bool load_save(std::size_t k);
+
+    // Returns nullptr if the save or the pins do not exist
+    Boundary* connect(std::string const& name, std::size_t from, Pin const* out, std::size_t to, Pin const* in);
+
+    // Same with the pin IDs of the save files, the saves do not need to be loaded
+    Boundary* connect(std::string const& name, std::size_t from, std::uint32_t out, std::size_t to, std::uint32_t in);
+
+    std::size_t find_save(std::string const& name) const;
+
+    // Simulate all the saves concurrently (one thread per save, started once), exchanging
+    // the boundary flows after each iteration until they change by less than tolerance.
+    // The saves not loaded yet are loaded first.
+    // Returns the number of iterations, max_iterations if the world did not converge,
+    // -1 if a save could not be loaded
+    int simulate(int max_iterations = 100, float tolerance = 1e-3f);
+
+    // Same as above but every save is simulated by its own worker process
+    // (the world_worker executable next to this one, talking over a Unix domain socket).
+    // A worker loads its save file on its own, the coordinator only keeps the boundary books:
+    // the saves do not need to be loaded here. The final production of the workers
+    // is copied into the loaded saves, the efficiency of the others is kept in WorldSave::efficiency.
+    // Falls back to threads when processes are not available (no worker executable,
+    // saves without a file); returns -1 if a worker failed
+    int simulate_processes(int max_iterations = 100, float tolerance = 1e-3f);
+
+    // Split a forest into parts saves written to directory/part_<k>.bin, nodes of the same
+    // line are kept together as much as possible; links crossing parts become boundaries.
+    // The parts keep the node and pin IDs of the forest and are not loaded
+    bool partition(Forest& forest, int parts, std::string const& directory);
+
+    // Loop of a worker process of simulate_processes, fd is its socket to the coordinator
+    // returns the exit code of the worker
+    static int run_worker(int fd);
+
+    // Reconcile the items in transit, returns the largest change since the last exchange
+    float exchange();
+
+    void clear();
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "lz.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Block format, a sequence of
+//
+//  uint8       token               literal count (high 4 bits), match length - 4 (low 4 bits)
+//  uint8       literal count [...] if the count in the token is 15, added until a byte below 255
+//  char        literals [count]
+//  uint16      offset              little endian, distance back to the match in the output
+//  uint8       match length [...]  if the length in the token is 15, same as the literals
+//
+// The last sequence stops after its literals
+namespace lz {
+namespace {
+
+constexpr std::size_t min_match  = 4;
+constexpr std::size_t max_offset = 65535;
+constexpr int         hash_bits  = 14;
+
+std::uint32_t read32(char const* p){
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+std::uint32_t hash(std::uint32_t v){
+    return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+char* write_length(char* out, std::size_t length){
+    for(; length >= 255; length -= 255){
+        *out++ = char(255);
+    }
+    *out++ = char(length);
+    return out;
+}
+
+char* write_sequence(char* out, char const* literals, std::size_t count, std::size_t offset, std::size_t length){
+    auto* token = out++;
+    auto match = length >= min_match ? length - min_match : 0;
+
+    *token = char(((count < 15 ? count : 15) << 4) | (match < 15 ? match : 15));
+
+    if (count >= 15){
+        out = write_length(out, count - 15);
+    }
+
+    if (count > 0){
+        std::memcpy(out, literals, count);
+        out += count;
+    }
+
+    if (length == 0)
+        return out;
+
+    *out++ = char(offset & 0xff);
+    *out++ = char(offset >> 8);
+
+    if (match >= 15){
+        out = write_length(out, match - 15);
+    }
+    return out;
+}
+
+}
+
+std::size_t compress(char const* src, std::size_t size, char* dst){
+    // positions in src, a candidate is checked before it is used
+    std::vector<std::uint32_t> table(std::size_t(1) << hash_bits, 0);
+
+    auto* end = src + size;
+    auto* limit = size > min_match ? end - min_match : src;
+    auto* anchor = src;
+    auto* in = src;
+    auto* out = dst;
+
+    while (in < limit){
+        auto v = read32(in);
+        auto& slot = table[hash(v)];
+        auto* candidate = src + slot;
+        slot = std::uint32_t(in - src);
+
+        if (candidate >= in || std::size_t(in - candidate) > max_offset || read32(candidate) != v){
+            in += 1;
+            continue;
+        }
+
+        auto length = min_match;
+        while (in + length < end && candidate[length] == in[length]){
+            length += 1;
+        }
+
+        out = write_sequence(out, anchor, std::size_t(in - anchor), std::size_t(in - candidate), length);
+        in += length;
+        anchor = in;
+    }
+
+    out = write_sequence(out, anchor, std::size_t(end - anchor), 0, 0);
+    return std::size_t(out - dst);
+}
+
+bool decompress(char const* src, std::size_t src_size, char* dst, std::size_t size){
+    auto* in = reinterpret_cast<std::uint8_t const*>(src);
+    auto* in_end = in + src_size;
+    auto* out = dst;
+    auto* out_end = dst + size;
+
+    auto read_length = [&](std::size_t length) -> std::size_t {
+        if (length < 15)
+            return length;
+
+        std::uint8_t byte = 255;
+        while (byte == 255 && in < in_end){
+            byte = *in++;
+            length += byte;
+        }
+        return length;
+    };
+
+    while (in < in_end){
+        auto token = *in++;
+
+        auto count = read_length(token >> 4);
+        if (count > std::size_t(in_end - in) || count > std::size_t(out_end - out))
+            return false;
+
+        if (count > 0){
+            std::memcpy(out, in, count);
+            in += count;
+            out += count;
+        }
+
+        if (in == in_end)
+            break;
+
+        if (in_end - in < 2)
+            return false;
+
+        auto offset = std::size_t(in[0]) | (std::size_t(in[1]) << 8);
+        in += 2;
+
+        auto length = read_length(token & 0x0f) + min_match;
+        if (offset == 0 || offset > std::size_t(out - dst) || length > std::size_t(out_end - out))
+            return false;
+
+        // the match can overlap the bytes it produces
+        auto* match = out - offset;
+        for(std::size_t i = 0; i < length; ++i){
+            out[i] = match[i];
+        }
+        out += length;
+    }
+
+    return out == out_end;
+}
+
+}
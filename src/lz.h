@@ -0,0 +1,25 @@
+#ifndef PUZZLE_LZ_HEADER
+#define PUZZLE_LZ_HEADER
+
+#include <cstddef>
+
+// Byte oriented LZ77 codec in the style of LZ4, see lz.cpp for the format
+// Blocks are independent, there is no state shared between two calls
+namespace lz {
+
+// Largest compressed size of size bytes
+constexpr std::size_t bound(std::size_t size){
+    return size + size / 255 + 16;
+}
+
+// Compress size bytes of src into dst (at least bound(size) bytes)
+// returns the compressed size
+std::size_t compress(char const* src, std::size_t size, char* dst);
+
+// Decompress a whole block into dst, size is the size it was compressed from
+// returns false if the block is corrupted, dst is not written past size
+bool decompress(char const* src, std::size_t src_size, char* dst, std::size_t size);
+
+}
+
+#endif
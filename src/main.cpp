@@ -84,7 +84,8 @@ int main(int argc, const char* argv[]) {
     MyGame app;
 
     if (load_save.size() > 0) {
-        app.editor.graph.load(load_save, true);
+        // loaded in the background, the editor shows the progress
+        app.editor.open_save(load_save);
     } else {
         assert(resources.buildings.size() > 0);
         int miner  = resources.find_building("Miner");
@@ -103,6 +104,8 @@ int main(int argc, const char* argv[]) {
         assertf(constructor >= 0, "constructor");
         assertf(iron_plate >= 0, "iron plate");
 
+        app.editor.graph.begin_batch();
+
         Node* n0 = app.editor.new_node(ImVec2(40 ,  50), miner, iron_ore);
         Node* n1 = app.editor.new_node(ImVec2(240 , 50), smelter, iron_ingot);
         Node* n2 = app.editor.new_node(ImVec2(440,  50), constructor, iron_plate);
@@ -120,6 +123,8 @@ int main(int argc, const char* argv[]) {
             auto inpin  = &n2->pins[LeftToRight][0];
             app.editor.new_link(outpin, inpin);
         }
+
+        app.editor.graph.commit();
     }
 
 
@@ -0,0 +1,70 @@
+#ifndef PUZZLE_MAPPED_FILE_HEADER
+#define PUZZLE_MAPPED_FILE_HEADER
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file
+struct MappedFile {
+    char const* data = nullptr;
+    std::size_t size = 0;
+
+    MappedFile(std::string const& path){
+#ifdef __linux__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0){
+            auto* ptr = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (ptr != MAP_FAILED){
+                data = static_cast<char const*>(ptr);
+                size = std::size_t(st.st_size);
+            }
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file)
+            return;
+
+        buffer.resize(std::size_t(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), std::streamsize(buffer.size()));
+        data = buffer.data();
+        size = buffer.size();
+#endif
+    }
+
+    ~MappedFile(){
+#ifdef __linux__
+        if (data != nullptr){
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+    }
+
+    MappedFile(MappedFile const&) = delete;
+
+    template<typename T>
+    T const* at(std::size_t offset) const {
+        return reinterpret_cast<T const*>(data + offset);
+    }
+
+#ifndef __linux__
+    std::vector<char> buffer;
+#endif
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "config.h"
+
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+
+// Compile the catalog of resources/*.json into a header of constexpr tables
+// (catalog_data.h) so the game starts without reading nor parsing anything,
+// see compiled_catalog.cpp
+//
+//  catalog_gen <resources directory> <header>
+namespace {
+
+std::string literal(std::string_view str){
+    std::string out = "\"";
+
+    for(auto c: str){
+        if (c == '"' || c == '\\'){
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// shortest representation that reads back to the same float
+std::string literal(float v){
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), v);
+    return "float(" + std::string(buffer, result.ptr) + ")";
+}
+
+std::string literal(BuildingKind kind){
+    switch (kind){
+    case BuildingKind::Producer:        return "BuildingKind::Producer";
+    case BuildingKind::Relay:           return "BuildingKind::Relay";
+    case BuildingKind::PipelineCross:   return "BuildingKind::PipelineCross";
+    case BuildingKind::Storage:         return "BuildingKind::Storage";
+    }
+    return "BuildingKind::Producer";
+}
+
+struct Table {
+    std::string   type;
+    std::string   name;
+    std::string   rows  = "";
+    std::uint32_t count = 0;
+
+    std::uint32_t add(std::string const& row){
+        rows += "    " + row + ",\n";
+        return count++;
+    }
+
+    std::string str() const {
+        return fmt::format("constexpr std::array<{}, {}> {} = {{{{\n{}}}}};\n\n", type, count, name, rows);
+    }
+};
+
+}
+
+int main(int argc, char* argv[]){
+    if (argc < 3){
+        std::fprintf(stderr, "usage: %s <resources directory> <header>\n", argv[0]);
+        return 2;
+    }
+
+    std::string dir = argv[1];
+    auto& rsc = Resources::instance();
+    rsc.load_json(dir);
+
+    Table items         {"std::string_view", "items"};
+    Table recipe_items  {"CompiledItem",     "recipe_items"};
+    Table recipes       {"CompiledRecipe",   "recipes"};
+    Table pins          {"std::string_view", "pins"};
+    Table sides         {"CompiledSide",     "sides"};
+    Table buildings     {"CompiledBuilding", "buildings"};
+
+    // in ID order
+    for(auto& item: rsc.items){
+        items.add(literal(item));
+    }
+
+    auto add_items = [&](std::vector<Item> const& list){
+        auto first = recipe_items.count;
+        for(auto& item: list){
+            recipe_items.add(fmt::format("{{{}, {}, {}, '{}'}}",
+                literal(item.name), literal(item.qty), literal(item.speed), item.type));
+        }
+        return first;
+    };
+
+    for(auto& building: rsc.buildings){
+        auto first_side = sides.count;
+        for(auto& side: building.layout){
+            auto first_pin = pins.count;
+            for(auto& pin: side.second){
+                pins.add(literal(pin));
+            }
+            sides.add(fmt::format("{{{}, {}, {}}}", literal(side.first), first_pin, side.second.size()));
+        }
+
+        auto first_recipe = recipes.count;
+        for(auto& recipe: building.recipes){
+            auto first_input = add_items(recipe.inputs);
+            auto first_output = add_items(recipe.outputs);
+
+            recipes.add(fmt::format("{{{}, {}, {}, {}, {}, {}, {}}}",
+                literal(recipe.recipe_name), literal(recipe.crafting_time), literal(recipe.texture),
+                first_input, recipe.inputs.size(), first_output, recipe.outputs.size()));
+        }
+
+        buildings.add(fmt::format("{{{}, {}, {}, {}, {}, {}, {}, {}, {}, {}}}",
+            literal(building.name), literal(building.energy),
+            literal(building.w), literal(building.l), literal(building.h),
+            literal(building_kind(building.name)),
+            first_side, building.layout.size(), first_recipe, building.recipes.size()));
+    }
+
+    std::string header =
+        "// Generated by catalog_gen from resources/*.json, do not edit\n"
+        "#ifndef PUZZLE_CATALOG_DATA_HEADER\n"
+        "#define PUZZLE_CATALOG_DATA_HEADER\n\n"
+        "#include <array>\n\n"
+        "namespace catalog_data {\n\n";
+
+    // ties the journals to the catalog as if it was loaded from the JSON files
+    header += fmt::format("constexpr std::uint64_t checksum = {}ull;\n\n", Resources::catalog_checksum(dir));
+
+    for(auto* table: {&items, &recipe_items, &recipes, &pins, &sides, &buildings}){
+        header += table->str();
+    }
+    header += "}\n\n#endif\n";
+
+    // written aside then renamed, an interrupted build does not leave half of it
+    std::string path = argv[2];
+    auto tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!file || !file.write(header.data(), std::streamsize(header.size()))){
+            std::fprintf(stderr, "Could not write %s\n", tmp.c_str());
+            return 1;
+        }
+    }
+
+    std::error_code err;
+    std::filesystem::rename(tmp, path, err);
+
+    if (err){
+        std::fprintf(stderr, "Could not write %s: %s\n", path.c_str(), err.message().c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,14 @@
+#include "factory/world.h"
+
+#include <cstdlib>
+
+// Worker process of World::simulate_processes
+// started by the coordinator with its end of the socket as argument
+int main(int argc, char* argv[]){
+    if (argc < 2){
+        return 2;
+    }
+
+    Resources::instance().load_configs();
+    return World::run_worker(std::atoi(argv[1]));
+}
@@ -3,7 +3,13 @@
 
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <future>
+#include <thread>
+
 #include <editor/node-editor.h>
+#include <editor/tiled_save.h>
+#include <factory/world.h>
 
 TEST(Forest, production_merger_splitter)
 {
@@ -24,5 +30,1233 @@ TEST(Forest, production_merger_splitter)
 
 }
 
-#endif
+TEST(Forest, traversal_orders)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner       = rsc.find_building("Miner");
+    int smelter     = rsc.find_building("Smelter");
+    int constructor = rsc.find_building("Constructor");
+
+    // miner -> smelter -> constructor
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = forest.new_node(ImVec2(100, 0), smelter, 0);
+    Node* n2 = forest.new_node(ImVec2(200, 0), constructor, 0);
+
+    forest.new_link(&n1->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+    forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+
+    std::vector<Node*> expected = {n0, n1, n2};
+    std::vector<Node*> visited;
+
+    forest.traverse([&](Node* n){ visited.push_back(n); });
+    EXPECT_EQ(visited, expected);
+
+    visited.clear();
+    forest.walk(Flow::Downstream, Order::DepthFirst, [&](Node* n){ visited.push_back(n); });
+    EXPECT_EQ(visited, expected);
+
+    visited.clear();
+    forest.topological([&](Node* n){ visited.push_back(n); });
+    EXPECT_EQ(visited, expected);
+
+    visited.clear();
+    forest.reverse([&](Node* n){ visited.push_back(n); });
+    std::reverse(expected.begin(), expected.end());
+    EXPECT_EQ(visited, expected);
+}
+
+TEST(Forest, batch_commit)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    forest.begin_batch();
+
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = forest.new_node(ImVec2(100, 0), smelter, 0);
+    Node* n2 = forest.new_node(ImVec2(100, 100), smelter, 0);
+
+    forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+    // replaces the previous link, the miner output can only be connected once
+    forest.new_link(&n0->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+
+    // nothing is applied until commit
+    auto revision = forest.revision();
+    EXPECT_EQ(n0->logic, nullptr);
+    EXPECT_EQ(forest.find_link(&n0->pins[RightToLeft][0]), nullptr);
+
+    forest.commit();
+
+    EXPECT_NE(forest.revision(), revision);
+    EXPECT_NE(n0->logic, nullptr);
+    EXPECT_EQ(forest.link_count(), 1);
+    EXPECT_EQ(forest.find_link(&n2->pins[LeftToRight][0]), forest.find_link(&n0->pins[RightToLeft][0]));
+    EXPECT_EQ(forest.roots().size(), 2u);
+}
+
+TEST(Forest, dense_ids)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int smelter = rsc.find_building("Smelter");
+
+    // IDs are local to each forest
+    Forest a;
+    Forest b;
+    Node* na = a.new_node(ImVec2(0, 0), smelter, 0);
+    Node* nb = b.new_node(ImVec2(0, 0), smelter, 0);
+
+    EXPECT_EQ(na->ID, 1u);
+    EXPECT_EQ(nb->ID, 1u);
+
+    // pins of a node are consecutive
+    auto pins = na->pins.all();
+    EXPECT_EQ(pins.size(), 2u);
+    EXPECT_EQ(pins[0].ID + 1, pins[1].ID);
+
+    // restart from the beginning once cleared
+    a.clear();
+    EXPECT_EQ(a.new_node(ImVec2(0, 0), smelter, 0)->ID, 1u);
+
+    // concurrent allocations do not overlap
+    IdAllocator ids;
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::uint32_t>> allocated(4);
+
+    for(auto& out: allocated){
+        threads.emplace_back([&ids, &out](){
+            for(int i = 0; i < 1000; ++i){
+                out.push_back(ids.allocate());
+            }
+        });
+    }
+
+    for(auto& t: threads){
+        t.join();
+    }
+
+    std::vector<std::uint32_t> all;
+    for(auto& out: allocated){
+        all.insert(all.end(), out.begin(), out.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    EXPECT_EQ(std::unique(all.begin(), all.end()), all.end());
+    EXPECT_EQ(ids.bound(), 4001u);
+}
+
+TEST(Forest, connected_components)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner       = rsc.find_building("Miner");
+    int smelter     = rsc.find_building("Smelter");
+    int constructor = rsc.find_building("Constructor");
+
+    // miner -> smelter -> constructor
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = forest.new_node(ImVec2(100, 0), smelter, 0);
+    Node* n2 = forest.new_node(ImVec2(200, 0), constructor, 0);
+
+    EXPECT_NE(forest.component(n0), forest.component(n1));
+
+    forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+    auto* link = forest.new_link(&n1->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+
+    auto line = forest.component(n0);
+    EXPECT_EQ(forest.component(n1), line);
+    EXPECT_EQ(forest.component(n2), line);
+
+    // splitting the line keeps the label for one of the parts
+    forest.remove_link(link);
+    EXPECT_EQ(forest.component(n0), line);
+    EXPECT_EQ(forest.component(n1), line);
+    EXPECT_NE(forest.component(n2), line);
+
+    forest.remove_node(n1);
+    EXPECT_NE(forest.component(n0), forest.component(n2));
+}
+
+TEST(Forest, reachability)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner       = rsc.find_building("Miner");
+    int smelter     = rsc.find_building("Smelter");
+    int constructor = rsc.find_building("Constructor");
+
+    // miner -> smelter -> constructor
+    //          smelter
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = forest.new_node(ImVec2(100, 0), smelter, 0);
+    Node* n2 = forest.new_node(ImVec2(200, 0), constructor, 0);
+    Node* n3 = forest.new_node(ImVec2(100, 100), smelter, 0);
+
+    forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+
+    // index the line before the next link so it is updated in place
+    EXPECT_TRUE(forest.feeds(n0, n1));
+    EXPECT_FALSE(forest.feeds(n0, n2));
+
+    forest.new_link(&n1->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+
+    EXPECT_TRUE(forest.feeds(n0, n2));
+    EXPECT_FALSE(forest.feeds(n2, n0));
+    EXPECT_FALSE(forest.feeds(n0, n3));
+
+    std::vector<Node*> upstream;
+    forest.for_each_upstream(n2, [&](Node* n){ upstream.push_back(n); });
+    std::sort(upstream.begin(), upstream.end());
+
+    std::vector<Node*> expected = {n0, n1, n2};
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(upstream, expected);
+
+    // the smelter is replaced
+    forest.new_link(&n3->pins[RightToLeft][0], &n2->pins[LeftToRight][0]);
+
+    EXPECT_FALSE(forest.feeds(n0, n2));
+    EXPECT_TRUE(forest.feeds(n3, n2));
+}
+
+TEST(Forest, reachability_large_line)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int splitter = rsc.find_building("Conveyor Splitter");
+    int miner    = rsc.find_building("Miner");
+
+    // one SCC per node, too many for the bitsets
+    auto count = int(Reachability::max_indexed) + 100;
+    std::vector<Node*> chain;
+
+    Forest forest;
+    forest.begin_batch();
+    for(int i = 0; i < count; ++i){
+        chain.push_back(forest.new_node(ImVec2(float(i) * 100, 0), splitter, -1));
+
+        if (i > 0){
+            forest.new_link(chain[i - 1]->output_pins()[0], chain[i]->input_pins()[0]);
+        }
+    }
+    forest.commit();
+
+    Node* other = forest.new_node(ImVec2(0, 500), miner, 0);
+
+    EXPECT_TRUE(forest.feeds(chain.front(), chain.back()));
+    EXPECT_FALSE(forest.feeds(chain.back(), chain.front()));
+    EXPECT_TRUE(forest.feeds(chain[10], chain[20]));
+    EXPECT_FALSE(forest.feeds(chain[20], chain[10]));
+    EXPECT_FALSE(forest.feeds(other, chain.back()));
+
+    std::size_t downstream = 0;
+    forest.for_each_downstream(chain[100], [&](Node*){ downstream += 1; });
+    EXPECT_EQ(downstream, std::size_t(count - 100));
+
+    // the line is cut, what was reached before is dropped
+    forest.remove_link(forest.find_link(chain[50]->input_pins()[0]));
+    EXPECT_FALSE(forest.feeds(chain[10], chain[60]));
+    EXPECT_TRUE(forest.feeds(chain[60], chain.back()));
+}
+
+TEST(Forest, spatial_index)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), smelter, 0);
+    Node* n1 = forest.new_node(ImVec2(1000, 0), smelter, 0);
+
+    EXPECT_EQ(forest.node_at(ImVec2(5, 5)), n0);
+    EXPECT_EQ(forest.node_at(ImVec2(500, 5)), nullptr);
+
+    int count = 0;
+    forest.query({ImVec2(-10, -10), ImVec2(2000, 100)}, [&](Node*){ count += 1; });
+    EXPECT_EQ(count, 2);
+
+    // the index follows the node
+    forest.move_node(n1, ImVec2(500, 0));
+    EXPECT_EQ(forest.node_at(ImVec2(505, 5)), n1);
+    EXPECT_EQ(forest.node_at(ImVec2(1005, 5)), nullptr);
+
+    auto& pin = n0->pins[RightToLeft][0];
+    EXPECT_EQ(forest.nearest_pin(pin.position() + ImVec2(3, 3), 10), &pin);
+
+    forest.remove_node(n0);
+    EXPECT_EQ(forest.node_at(ImVec2(5, 5)), nullptr);
+}
+
+TEST(Forest, undo_redo)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    History history(forest);
+
+    Node* n0 = history.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = history.new_node(ImVec2(100, 0), smelter, 0);
+    history.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+    history.rotate_node(n1, 1);
+
+    auto id = n1->ID;
+    auto pin = n1->pins.all()[0].ID;
+
+    // removing the node removes its link, both are restored in one step
+    history.remove_node(n1);
+    EXPECT_EQ(forest.node_count(), 1);
+    EXPECT_EQ(forest.link_count(), 0);
+
+    EXPECT_TRUE(history.undo());
+    n1 = forest.find_node(id);
+    ASSERT_NE(n1, nullptr);
+    EXPECT_EQ(n1->pins.all()[0].ID, pin);
+    EXPECT_EQ(n1->rotation, 1);
+    EXPECT_EQ(forest.link_count(), 1);
+    EXPECT_TRUE(forest.feeds(n0, n1));
+
+    // rotation, link, smelter, miner
+    EXPECT_TRUE(history.undo());
+    EXPECT_EQ(n1->rotation, 0);
+    EXPECT_TRUE(history.undo());
+    EXPECT_EQ(forest.link_count(), 0);
+    EXPECT_TRUE(history.undo());
+    EXPECT_TRUE(history.undo());
+    EXPECT_EQ(forest.node_count(), 0);
+    EXPECT_FALSE(history.undo());
+
+    while (history.redo()){}
+    EXPECT_EQ(forest.node_count(), 1);
+    EXPECT_EQ(forest.find_node(id), nullptr);
+
+    history.undo();
+    EXPECT_EQ(forest.link_count(), 1);
+    EXPECT_EQ(forest.find_node(id)->rotation, 1);
+}
+
+TEST(Forest, copy_paste)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    History history(forest);
+
+    Node* n0 = history.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = history.new_node(ImVec2(100, 0), smelter, 0);
+    history.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+
+    Clipboard clipboard;
+    clipboard.copy(forest, {n0, n1});
+    EXPECT_EQ(clipboard.nodes.size(), 2u);
+    EXPECT_EQ(clipboard.links.size(), 1u);
+
+    auto& created = clipboard.paste(history, ImVec2(0, 200), 40);
+    EXPECT_EQ(created.size(), 80u);
+    EXPECT_EQ(forest.node_count(), 82);
+    EXPECT_EQ(forest.link_count(), 41);
+
+    // every copy is its own line
+    EXPECT_TRUE(forest.feeds(created[0], created[1]));
+    EXPECT_FALSE(forest.feeds(created[0], created[3]));
+    EXPECT_EQ(created[1]->Pos.x - created[0]->Pos.x, 100.f);
+
+    // pasting is a single undo step
+    history.undo();
+    EXPECT_EQ(forest.node_count(), 2);
+    EXPECT_EQ(forest.link_count(), 1);
+
+    history.redo();
+    EXPECT_EQ(forest.node_count(), 82);
+    EXPECT_EQ(forest.link_count(), 41);
+    EXPECT_FALSE(history.can_redo());
+}
+
+TEST(Forest, bulk_remove)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    History history(forest);
+
+    Node* n0 = history.new_node(ImVec2(0, 0), miner, 0);
+    Node* n1 = history.new_node(ImVec2(100, 0), smelter, 0);
+    history.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+
+    Clipboard clipboard;
+    clipboard.copy(forest, {n0, n1});
+    std::vector<Node*> created = clipboard.paste(history, ImVec2(0, 200), 1000);
+
+    // group move
+    forest.move_nodes(created, ImVec2(0, 100));
+    EXPECT_EQ(forest.node_at(created[0]->Pos + ImVec2(1, 1)), created[0]);
+
+    history.remove_nodes(created);
+    EXPECT_EQ(forest.node_count(), 2);
+    EXPECT_EQ(forest.link_count(), 1);
+
+    history.undo();
+    EXPECT_EQ(forest.node_count(), 2002);
+    EXPECT_EQ(forest.link_count(), 1001);
+
+    // undo the paste
+    history.undo();
+    EXPECT_EQ(forest.node_count(), 2);
+    EXPECT_EQ(forest.link_count(), 1);
+    EXPECT_TRUE(forest.feeds(n0, n1));
+}
+
+TEST(Forest, world_boundary)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    World world;
+    auto outpost = world.add_save("outpost");
+    auto base    = world.add_save("base");
+
+    Node* n0 = world.saves[outpost].forest->new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    Node* n1 = world.saves[base].forest->new_node(ImVec2(0, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+
+    auto* boundary = world.connect("train", outpost, &n0->pins[RightToLeft][0], base, &n1->pins[LeftToRight][0]);
+    ASSERT_NE(boundary, nullptr);
+
+    auto iterations = world.simulate(100);
+    EXPECT_LT(iterations, 100);
+
+    // the ore mined in the outpost is smelted in the base
+    // the smelter is the bottleneck
+    EXPECT_FLOAT_EQ(n1->efficiency, 1.f);
+    EXPECT_FLOAT_EQ(n0->efficiency, 0.75f);
+    EXPECT_FLOAT_EQ(boundary->transit["Caterium Ore"].received, 45.f);
+}
+
+TEST(Forest, world_processes)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> lines;
+
+    forest.begin_batch();
+    for(int i = 0; i < 4; ++i){
+        Node* n0 = forest.new_node(ImVec2(0, float(i) * 100), miner, rsc.find_recipe(miner, "Caterium Ore"));
+        Node* n1 = forest.new_node(ImVec2(100, float(i) * 100), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+        forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+        lines.emplace_back(n0->ID, n1->ID);
+    }
+    forest.commit();
+
+    // each line is cut in half, the parts are only loaded by the workers
+    auto directory = std::filesystem::temp_directory_path() / "puzzle_world";
+    std::filesystem::create_directories(directory);
+
+    World world;
+    EXPECT_TRUE(world.partition(forest, 8, directory.string()));
+    EXPECT_EQ(world.saves.size(), 8u);
+    EXPECT_EQ(world.boundaries.size(), 4u);
+
+    auto iterations = world.simulate_processes(100);
+    EXPECT_GT(iterations, 0);
+    EXPECT_LT(iterations, 100);
+
+    // the saves are loaded here when the worker executable is missing
+    auto efficiency = [&](std::uint32_t id){
+        for(auto& save: world.saves){
+            if (save.forest != nullptr && save.forest->find_node(id) != nullptr)
+                return save.forest->find_node(id)->efficiency;
+
+            if (save.efficiency.count(id) > 0)
+                return save.efficiency.at(id);
+        }
+        return -1.f;
+    };
+
+    for(auto& boundary: world.boundaries){
+        EXPECT_FLOAT_EQ(boundary->transit["Caterium Ore"].received, 45.f);
+    }
+
+    for(auto& line: lines){
+        EXPECT_FLOAT_EQ(efficiency(line.first), 0.75f);
+        EXPECT_FLOAT_EQ(efficiency(line.second), 1.f);
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(Forest, world_load)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    auto saves = puzzle::binary_path() + "/saves/";
+
+    Forest outpost;
+    Node* n0 = outpost.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    EXPECT_TRUE(outpost.save_binary(saves + "puzzle_world_outpost.bin"));
+
+    Forest base;
+    Node* n1 = base.new_node(ImVec2(0, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+    EXPECT_TRUE(base.save_binary(saves + "puzzle_world_base.bin"));
+
+    json links = json::array();
+    links.push_back({
+        {"name", "train"},
+        {"export", {{"save", "puzzle_world_outpost"}, {"pin", n0->pins[RightToLeft][0].ID}}},
+        {"import", {{"save", "puzzle_world_base"}, {"pin", n1->pins[LeftToRight][0].ID}}}
+    });
+
+    json desc = {{"saves", {"puzzle_world_outpost", "puzzle_world_base"}}, {"links", links}};
+    std::ofstream(saves + "puzzle_world.world.json") << desc.dump();
+
+    // the saves keep their file so the workers can load them
+    World world;
+    ASSERT_TRUE(world.load("puzzle_world"));
+    ASSERT_EQ(world.saves.size(), 2u);
+    ASSERT_EQ(world.boundaries.size(), 1u);
+
+    for(auto& save: world.saves){
+        EXPECT_FALSE(save.path.empty());
+        EXPECT_EQ(save.forest, nullptr);
+    }
+
+    auto iterations = world.simulate_processes(100);
+    EXPECT_GT(iterations, 0);
+    EXPECT_LT(iterations, 100);
+
+    // loaded here only when the worker executable is missing
+    auto efficiency = [&](WorldSave& save, std::uint32_t id){
+        if (save.forest != nullptr)
+            return save.forest->find_node(id)->efficiency;
+        return save.efficiency.count(id) > 0 ? save.efficiency.at(id) : -1.f;
+    };
+
+    EXPECT_FLOAT_EQ(world.boundaries[0]->transit["Caterium Ore"].received, 45.f);
+    EXPECT_FLOAT_EQ(efficiency(world.saves[0], n0->ID), 0.75f);
+    EXPECT_FLOAT_EQ(efficiency(world.saves[1], n1->ID), 1.f);
+
+    std::filesystem::remove(saves + "puzzle_world_outpost.bin");
+    std::filesystem::remove(saves + "puzzle_world_base.bin");
+    std::filesystem::remove(saves + "puzzle_world.world.json");
+}
+
+TEST(Forest, compiled_schedule)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    Node* n1 = forest.new_node(ImVec2(100, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+    forest.new_link(&n0->pins[RightToLeft][0], &n1->pins[LeftToRight][0]);
+
+    Simulation sim(&forest);
+    for(int i = 0; i < 10; ++i){
+        sim.compute_production();
+    }
+
+    // schedule follows the traversal
+    std::vector<SimulationLogic*> expected = {n0->logic.get(), n1->logic.get()};
+    EXPECT_EQ(sim.schedule(), expected);
+    EXPECT_FLOAT_EQ(n1->efficiency, 0.75f);
+
+    // the logic is reallocated when the forest changes, production is kept
+    auto produced = n1->production().at("Caterium Ingot").produced;
+    forest.new_node(ImVec2(0, 100), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    sim.compile();
+
+    EXPECT_EQ(sim.schedule().size(), 3u);
+    EXPECT_FLOAT_EQ(n1->production().at("Caterium Ingot").produced, produced);
+
+    sim.compute_production();
+    EXPECT_FLOAT_EQ(n1->efficiency, 0.75f);
+}
+
+TEST(Forest, fused_relays)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner    = rsc.find_building("Miner");
+    int smelter  = rsc.find_building("Smelter");
+    int splitter = rsc.find_building("Conveyor Splitter");
 
+    // miner -> splitter -> splitter -> 5 smelters
+    auto build = [&](Forest& forest){
+        std::vector<Node*> nodes;
+        nodes.push_back(forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore")));
+        nodes.push_back(forest.new_node(ImVec2(100, 0), splitter, -1));
+        nodes.push_back(forest.new_node(ImVec2(200, 0), splitter, -1));
+
+        forest.new_link(nodes[0]->output_pins()[0], nodes[1]->input_pins()[0]);
+        forest.new_link(nodes[1]->output_pins()[0], nodes[2]->input_pins()[0]);
+
+        for(int i = 0; i < 5; ++i){
+            auto* relay = i < 2 ? nodes[1] : nodes[2];
+            auto* n = forest.new_node(ImVec2(300, float(i) * 100), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+            forest.new_link(relay->output_pins()[std::size_t(i < 2 ? i + 1 : i - 2)], n->input_pins()[0]);
+            nodes.push_back(n);
+        }
+        return nodes;
+    };
+
+    Forest reference;
+    auto expected = build(reference);
+
+    Forest forest;
+    auto nodes = build(forest);
+    Simulation sim(&forest);
+
+    for(int i = 0; i < 20; ++i){
+        reference.traverse([](Node* n){ n->logic->tick(); });
+        sim.compute_production();
+    }
+
+    // the two splitters are ticked as one node
+    EXPECT_EQ(sim.schedule().size(), nodes.size() - 1);
+
+    auto* fused = dynamic_cast<DistributionLogic*>(sim.schedule()[1]);
+    ASSERT_NE(fused, nullptr);
+    EXPECT_EQ(fused->head, nodes[1]->logic.get());
+    ASSERT_EQ(fused->outputs.size(), 5u);
+    EXPECT_FLOAT_EQ(fused->outputs[0].fraction, 1.f / 3.f);
+    EXPECT_FLOAT_EQ(fused->outputs[2].fraction, 1.f / 9.f);
+
+    // same flows as relays ticked one after the other,
+    // the second splitter is not ticked anymore
+    for(auto i = 0u; i < nodes.size(); ++i){
+        if (i == 2)
+            continue;
+
+        EXPECT_FLOAT_EQ(nodes[i]->efficiency, expected[i]->efficiency);
+
+        for(auto& item: expected[i]->production()){
+            auto& stat = nodes[i]->production().at(item.first);
+            EXPECT_NEAR(stat.received, item.second.received, 1e-3f);
+            EXPECT_NEAR(stat.consumed, item.second.consumed, 1e-3f);
+            EXPECT_NEAR(stat.produced, item.second.produced, 1e-3f);
+        }
+    }
+}
+
+TEST(Forest, splitter_rules)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner    = rsc.find_building("Miner");
+    int smelter  = rsc.find_building("Smelter");
+    int splitter = rsc.find_building("Conveyor Splitter");
+
+    Forest forest;
+    Node* source = forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    Node* relay  = forest.new_node(ImVec2(100, 0), splitter, -1);
+    Node* a      = forest.new_node(ImVec2(200, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+    Node* b      = forest.new_node(ImVec2(200, 100), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+
+    forest.new_link(source->output_pins()[0], relay->input_pins()[0]);
+    forest.new_link(relay->output_pins()[0], a->input_pins()[0]);
+    forest.new_link(relay->output_pins()[1], b->input_pins()[0]);
+
+    auto run = [&](){
+        for(int i = 0; i < 50; ++i){
+            forest.traverse([](Node* n){ n->logic->tick(); });
+        }
+    };
+
+    // only Caterium Ore to the first output
+    forest.set_rules(relay, {
+        {SplitterRule::Item, "Caterium Ore"},
+        {SplitterRule::None, ""},
+    });
+
+    auto* logic = static_cast<RelayLogic*>(relay->logic.get());
+    EXPECT_TRUE(logic->programmed);
+    EXPECT_EQ(logic->routes.size(), rsc.items.size());
+    EXPECT_EQ(logic->routes[std::size_t(rsc.find_item("Caterium Ore"))], 1);
+
+    run();
+    EXPECT_GT(a->efficiency, 0.f);
+    EXPECT_FLOAT_EQ(b->efficiency, 0.f);
+
+    // the miner produces more than a smelter consumes, the rest overflows
+    forest.set_rules(relay, {
+        {SplitterRule::Item, "Caterium Ore"},
+        {SplitterRule::Overflow, ""},
+    });
+
+    run();
+    EXPECT_GT(b->efficiency, 0.f);
+
+    // no rules, even split
+    forest.set_rules(relay, {});
+    EXPECT_FALSE(logic->programmed);
+    EXPECT_EQ(forest.find_rules(relay), nullptr);
+}
+
+TEST(Forest, splitter_rules_history)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int splitter = rsc.find_building("Conveyor Splitter");
+
+    Forest forest;
+    History history(forest);
+
+    Node* relay = history.new_node(ImVec2(0, 0), splitter, -1);
+    auto id = relay->ID;
+
+    SplitterRules rules = {
+        {SplitterRule::Item, "Caterium Ore"},
+        {SplitterRule::Overflow, ""},
+    };
+
+    auto same = [](SplitterRules const* a, SplitterRules const& b){
+        if (a == nullptr || a->size() != b.size())
+            return false;
+
+        for(auto i = 0u; i < b.size(); ++i){
+            if ((*a)[i].kind != b[i].kind || (*a)[i].item != b[i].item)
+                return false;
+        }
+        return true;
+    };
+
+    history.set_rules(relay, rules);
+    EXPECT_TRUE(same(forest.find_rules(relay), rules));
+
+    history.set_rules(relay, {{SplitterRule::None, ""}});
+    EXPECT_EQ(forest.find_rules(relay)->size(), 1u);
+
+    // one step per set_rules
+    history.undo();
+    EXPECT_TRUE(same(forest.find_rules(relay), rules));
+    history.undo();
+    EXPECT_EQ(forest.find_rules(relay), nullptr);
+    history.redo();
+    EXPECT_TRUE(same(forest.find_rules(relay), rules));
+
+    // the rules come back with the node
+    history.remove_node(relay);
+    history.undo();
+    relay = forest.find_node(id);
+    ASSERT_NE(relay, nullptr);
+    EXPECT_TRUE(same(forest.find_rules(relay), rules));
+    EXPECT_TRUE(static_cast<RelayLogic*>(relay->logic.get())->programmed);
+
+    // and with the copies
+    Clipboard clipboard;
+    clipboard.copy(forest, {relay});
+    auto& created = clipboard.paste(history, ImVec2(0, 200));
+    ASSERT_EQ(created.size(), 1u);
+    EXPECT_TRUE(same(forest.find_rules(created[0]), rules));
+}
+
+TEST(Forest, binary_save)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner    = rsc.find_building("Miner");
+    int smelter  = rsc.find_building("Smelter");
+    int splitter = rsc.find_building("Conveyor Splitter");
+
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    Node* n1 = forest.new_node(ImVec2(100, 0), splitter, -1, 1);
+    Node* n2 = forest.new_node(ImVec2(200, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+
+    forest.new_link(n0->output_pins()[0], n1->input_pins()[0]);
+    forest.new_link(n1->output_pins()[2], n2->input_pins()[0]);
+    forest.set_rules(n1, {{SplitterRule::None, ""}, {SplitterRule::Overflow, ""}, {SplitterRule::Item, "Caterium Ore"}});
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_binary_save.bin").string();
+    ASSERT_TRUE(forest.save_binary(path));
+
+    Forest loaded;
+    PinRemap pins;
+    ASSERT_TRUE(loaded.load_binary(path, &pins));
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(loaded.node_count(), 3);
+    EXPECT_EQ(loaded.link_count(), 2);
+
+    // pins are referred to by the IDs of the saving forest
+    auto* in = pins.get(n2->input_pins()[0]->ID);
+    auto* link = loaded.find_link(in);
+    ASSERT_NE(link, nullptr);
+    EXPECT_EQ(link->start, pins.get(n1->output_pins()[2]->ID));
+
+    auto* relay = in == link->end ? link->start->parent : link->end->parent;
+    EXPECT_EQ(relay->rotation, 1);
+    EXPECT_EQ(relay->Pos.x, 100.f);
+    EXPECT_EQ(in->parent->recipe(), n2->recipe());
+
+    auto* rules = loaded.find_rules(relay);
+    ASSERT_NE(rules, nullptr);
+    ASSERT_EQ(rules->size(), 3u);
+    EXPECT_EQ((*rules)[1].kind, SplitterRule::Overflow);
+    EXPECT_EQ((*rules)[2].item, "Caterium Ore");
+}
+
+TEST(Forest, streaming_json_load)
+{
+    Resources::instance().load_configs();
+
+    // reference: the whole document
+    std::ifstream file(puzzle::binary_path() + "/saves/reinforced_plate.json");
+    json document;
+    file >> document;
+
+    Forest expected;
+    from_json(document, expected);
+
+    float progress = 0;
+    Forest forest;
+    forest.import_json("reinforced_plate", false, nullptr, [&](float p){
+        EXPECT_GE(p, progress);
+        progress = p;
+    });
+
+    EXPECT_FLOAT_EQ(progress, 1.f);
+    EXPECT_GT(forest.node_count(), 0);
+    EXPECT_EQ(forest.node_count(), expected.node_count());
+    EXPECT_EQ(forest.link_count(), expected.link_count());
+}
+
+TEST(Forest, json_export)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner    = rsc.find_building("Miner");
+    int splitter = rsc.find_building("Conveyor Splitter");
+
+    Forest forest;
+    Node* n0 = forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    Node* n1 = forest.new_node(ImVec2(100, 0), splitter, -1, 1);
+    forest.new_link(n0->output_pins()[0], n1->input_pins()[0]);
+    forest.set_rules(n1, {{SplitterRule::Overflow, ""}, {SplitterRule::Item, "Caterium Ore"}});
+
+    ASSERT_TRUE(forest.export_json("puzzle_json_export", true));
+    EXPECT_FALSE(forest.export_json("puzzle_json_export"));
+
+    // the nodes come first so the import does not buffer the links
+    std::string start(9, ' ');
+    std::ifstream(puzzle::binary_path() + "/saves/puzzle_json_export.json").read(start.data(), 9);
+    EXPECT_EQ(start, "{\"nodes\":");
+
+    Forest imported;
+    imported.import_json("puzzle_json_export");
+    std::filesystem::remove(puzzle::binary_path() + "/saves/puzzle_json_export.json");
+
+    EXPECT_EQ(imported.node_count(), 2);
+    EXPECT_EQ(imported.link_count(), 1);
+
+    Node* relay = nullptr;
+    for(auto& node: imported.iter_nodes()){
+        if (node.is_relay()){
+            relay = &node;
+        }
+    }
+
+    ASSERT_NE(relay, nullptr);
+    EXPECT_EQ(relay->rotation, 1);
+    EXPECT_EQ(relay->Pos.x, 100.f);
+
+    auto* rules = imported.find_rules(relay);
+    ASSERT_NE(rules, nullptr);
+    ASSERT_EQ(rules->size(), 2u);
+    EXPECT_EQ((*rules)[0].kind, SplitterRule::Overflow);
+    EXPECT_EQ((*rules)[1].item, "Caterium Ore");
+}
+
+TEST(Forest, bulk_insert)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+    int ore     = rsc.find_recipe(miner, "Caterium Ore");
+    int ingot   = rsc.find_recipe(smelter, "Caterium Ingot");
+
+    // large enough to be split across threads
+    std::vector<NodeSpec> specs;
+    for(int i = 0; i < 10000; ++i){
+        specs.push_back({ImVec2(0, float(i) * 100), miner, ore});
+        specs.push_back({ImVec2(100, float(i) * 100), smelter, ingot});
+    }
+
+    Forest forest;
+    std::vector<Node*> nodes;
+
+    forest.begin_batch();
+    forest.new_nodes(specs, nodes, 4);
+
+    std::vector<std::pair<Pin const*, Pin const*>> ends;
+    for(auto i = 0u; i < nodes.size(); i += 2){
+        ends.emplace_back(nodes[i]->output_pins()[0], nodes[i + 1]->input_pins()[0]);
+    }
+    forest.new_links(ends, 4);
+    forest.commit();
+
+    EXPECT_EQ(forest.node_count(), 20000);
+    EXPECT_EQ(forest.link_count(), 10000);
+
+    // IDs follow the specs, nodes are listed in order
+    std::uint32_t id = nodes[0]->ID;
+    for(auto& node: forest.iter_nodes()){
+        EXPECT_EQ(node.ID, id);
+        EXPECT_EQ(forest.find_node(id), &node);
+        EXPECT_NE(node.logic, nullptr);
+        id += 1;
+    }
+
+    EXPECT_EQ(forest.find_link(nodes[2]->output_pins()[0])->end, nodes[3]->input_pins()[0]);
+    EXPECT_EQ(forest.component(nodes[0]), forest.component(nodes[1]));
+    EXPECT_NE(forest.component(nodes[0]), forest.component(nodes[2]));
+}
+
+TEST(Forest, atomic_save)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner = rsc.find_building("Miner");
+
+    Forest forest;
+    forest.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_atomic_save.bin").string();
+    auto records = forest.snapshot();
+
+    // the forest can change once the snapshot is taken
+    forest.new_node(ImVec2(100, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+
+    auto written = std::async(std::launch::async, [&](){
+        return Forest::write_snapshot(*records, path);
+    });
+    ASSERT_TRUE(written.get());
+
+    // no temporary file is left behind
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    Forest loaded;
+    ASSERT_TRUE(loaded.load_binary(path));
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(loaded.node_count(), 1);
+}
+
+TEST(Forest, autosave_journal)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_journal.bin").string();
+    auto journal_path = (std::filesystem::temp_directory_path() / "puzzle_journal.journal").string();
+
+    Forest forest;
+    History history(forest);
+    Journal journal(forest, path);
+    history.set_journal(&journal);
+
+    Node* n0 = history.new_node(ImVec2(0, 0), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    ASSERT_TRUE(journal.compact().get());
+    journal.autosave();
+
+    // only the edits are written from now on
+    Node* n1 = history.new_node(ImVec2(200, 0), smelter, rsc.find_recipe(smelter, "Caterium Ingot"));
+    history.new_link(n0->output_pins()[0], n1->input_pins()[0]);
+
+    forest.move_node(n1, ImVec2(300, 0));
+    history.moved(n1, ImVec2(200, 0));
+
+    history.new_node(ImVec2(0, 200), miner, rsc.find_recipe(miner, "Caterium Ore"));
+    history.undo();
+    history.rotate_node(n0, 2);
+
+    ASSERT_TRUE(journal.autosave());
+    EXPECT_EQ(journal.size(), 6u);
+
+    // after a crash the journal is replayed on top of the save
+    Forest recovered;
+    Journal replay(recovered, path);
+    EXPECT_EQ(replay.recover(), 6u);
+
+    EXPECT_EQ(recovered.node_count(), 2);
+    EXPECT_EQ(recovered.link_count(), 1);
+
+    // the nodes have the IDs of the crashed session
+    auto* r0 = recovered.find_node(n0->ID);
+    auto* r1 = recovered.find_node(n1->ID);
+    ASSERT_NE(r0, nullptr);
+    ASSERT_NE(r1, nullptr);
+
+    EXPECT_EQ(r0->rotation, 2);
+    EXPECT_EQ(r1->Pos.x, 300.f);
+    EXPECT_NE(recovered.find_link(r1->input_pins()[0]), nullptr);
+
+    // the journal carries on from the recovered forest
+    History recovered_history(recovered);
+    recovered_history.set_journal(&replay);
+    recovered_history.rotate_node(r1, 1);
+    ASSERT_TRUE(replay.autosave());
+
+    Forest reopened;
+    Journal again(reopened, path);
+    EXPECT_EQ(again.recover(), 7u);
+    EXPECT_EQ(reopened.node_count(), 2);
+    EXPECT_EQ(reopened.find_node(n1->ID)->rotation, 1);
+
+    // edits that do not apply are skipped
+    Edit unknown;
+    unknown.kind = EditKind::AddNode;
+    unknown.id = n1->ID + 100;
+    unknown.building = int(rsc.buildings.size());
+    again.append(unknown, true);
+    ASSERT_TRUE(again.autosave());
+
+    Forest skipped;
+    Journal last(skipped, path);
+    EXPECT_EQ(last.recover(), 8u);
+    EXPECT_EQ(skipped.node_count(), 2);
+
+    // a journal written with other resources is not replayed
+    rsc.checksum += 1;
+    EXPECT_EQ(last.recoverable(), 0u);
+    rsc.checksum -= 1;
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(journal_path);
+}
+
+TEST(Forest, tiled_save)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner   = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+    int ore     = rsc.find_recipe(miner, "Caterium Ore");
+    int ingot   = rsc.find_recipe(smelter, "Caterium Ingot");
+
+    // a line inside a tile and a line across two tiles
+    Forest forest;
+    Node* a0 = forest.new_node(ImVec2(0, 0), miner, ore);
+    Node* a1 = forest.new_node(ImVec2(200, 0), smelter, ingot);
+    Node* b0 = forest.new_node(ImVec2(10000, 0), miner, ore);
+    Node* b1 = forest.new_node(ImVec2(0, 10000), smelter, ingot);
+
+    forest.new_link(a0->output_pins()[0], a1->input_pins()[0]);
+    forest.new_link(b0->output_pins()[0], b1->input_pins()[0]);
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_tiled_save.bin").string();
+    ASSERT_TRUE(forest.save_binary(path));
+
+    Forest streamed;
+    TiledSave tiles(streamed, path);
+    ASSERT_TRUE(tiles.valid());
+    EXPECT_EQ(tiles.missing_count(), 3u);
+
+    // only the tile in view
+    EXPECT_EQ(tiles.load(Box{ImVec2(0, 0), ImVec2(500, 500)}), 1u);
+    EXPECT_EQ(streamed.node_count(), 2);
+    EXPECT_EQ(streamed.link_count(), 1);
+    EXPECT_NE(streamed.find_node(a1->ID), nullptr);
+
+    // the link between two tiles waits for both of them
+    EXPECT_EQ(tiles.load_next(1), 1u);
+    EXPECT_EQ(streamed.link_count(), 1);
+
+    tiles.load_all();
+    std::filesystem::remove(path);
+
+    EXPECT_TRUE(tiles.complete());
+    EXPECT_EQ(streamed.node_count(), 4);
+    EXPECT_EQ(streamed.link_count(), 2);
+
+    auto* end = streamed.find_node(b1->ID);
+    ASSERT_NE(end, nullptr);
+    EXPECT_NE(streamed.find_link(end->input_pins()[0]), nullptr);
+}
+
+TEST(Forest, compiled_catalog)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_catalog.bin").string();
+    auto checksum = Resources::catalog_checksum(puzzle::binary_path() + "/resources");
+    ASSERT_TRUE(rsc.save_catalog(path, checksum));
+
+    // the catalog compiled in is the one of the JSON files
+    EXPECT_EQ(rsc.checksum, checksum);
+
+    std::size_t buildings = rsc.buildings.size();
+    std::size_t items = rsc.items.size();
+    int miner = rsc.find_building("Miner");
+    int recipe = rsc.find_recipe(miner, "Caterium Ore");
+
+    // outdated catalogs are rebuilt from the JSON files
+    EXPECT_FALSE(rsc.load_catalog(path, checksum + 1));
+
+    ASSERT_TRUE(rsc.load_catalog(path, checksum));
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(rsc.buildings.size(), buildings);
+    EXPECT_EQ(rsc.items.size(), items);
+    EXPECT_EQ(rsc.find_building("Miner"), miner);
+    EXPECT_EQ(rsc.find_recipe(miner, "Caterium Ore"), recipe);
+    EXPECT_EQ(rsc.buildings[std::size_t(miner)].pin_count(), 1u);
+
+    // pins are numbered by side in the same order however the catalog was loaded
+    auto& merger = rsc.buildings[std::size_t(rsc.find_building("Conveyor Merger"))];
+    std::vector<std::string> sides;
+    for(auto& side: merger.layout){
+        sides.push_back(side.first);
+    }
+    EXPECT_EQ(sides, (std::vector<std::string>{"right", "top", "left", "bottom"}));
+}
+
+TEST(Forest, recipe_index)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int smelter = rsc.find_building("Smelter");
+    int ingot = rsc.find_recipe(smelter, "Iron Ingot");
+    ASSERT_GE(ingot, 0);
+
+    EXPECT_EQ(rsc.find_building("Unknown"), -1);
+    EXPECT_EQ(rsc.find_recipe(smelter, "Unknown"), -1);
+    EXPECT_EQ(rsc.find_recipe(-1, "Iron Ingot"), -1);
+
+    auto produced = [&](int item){
+        for(auto& ref: rsc.producers(item)){
+            if (ref.building == smelter && ref.recipe == ingot)
+                return true;
+        }
+        return false;
+    };
+
+    auto consumed = [&](int item){
+        for(auto& ref: rsc.consumers(item)){
+            if (ref.building == smelter && ref.recipe == ingot)
+                return true;
+        }
+        return false;
+    };
+
+    EXPECT_TRUE(produced(rsc.find_item("Iron Ingot")));
+    EXPECT_TRUE(consumed(rsc.find_item("Iron Ore")));
+    EXPECT_FALSE(produced(rsc.find_item("Iron Ore")));
+    EXPECT_TRUE(rsc.producers(-1).empty());
+}
+
+TEST(Forest, compressed_save)
+{
+    auto& rsc = Resources::instance();
+    rsc.load_configs();
+
+    int miner = rsc.find_building("Miner");
+    int smelter = rsc.find_building("Smelter");
+
+    // large enough to span several blocks, decompressed in parallel
+    Forest forest;
+    forest.begin_batch();
+    for(auto i = 0; i < 20000; ++i){
+        auto* m = forest.new_node(ImVec2(float(i % 200) * 100, float(i / 200) * 400), miner, rsc.find_recipe(miner, "Iron Ore"));
+        auto* s = forest.new_node(ImVec2(float(i % 200) * 100, float(i / 200) * 400 + 200), smelter, rsc.find_recipe(smelter, "Iron Ingot"));
+        forest.new_link(m->output_pins()[0], s->input_pins()[0]);
+    }
+    forest.commit();
+
+    auto path = (std::filesystem::temp_directory_path() / "puzzle_compressed_save.bin").string();
+    auto plain = (std::filesystem::temp_directory_path() / "puzzle_plain_save.bin").string();
+
+    auto records = forest.snapshot(7);
+    ASSERT_TRUE(Forest::write_snapshot(*records, path, true));
+    ASSERT_TRUE(Forest::write_snapshot(*records, plain));
+
+    EXPECT_TRUE(Forest::is_compressed_save(path));
+    EXPECT_FALSE(Forest::is_compressed_save(plain));
+    EXPECT_LT(std::filesystem::file_size(path), std::filesystem::file_size(plain));
+    EXPECT_GT(std::filesystem::file_size(plain), 4u * 256 * 1024);
+    EXPECT_EQ(Forest::save_generation(path), 7u);
+
+    Forest loaded;
+    ASSERT_TRUE(loaded.load_binary(path, nullptr, 4));
+
+    EXPECT_EQ(loaded.node_count(), forest.node_count());
+    EXPECT_EQ(loaded.link_count(), forest.link_count());
+
+    // a damaged or truncated save is not loaded
+    std::vector<char> bytes(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(bytes.data(), std::streamsize(bytes.size()));
+
+    auto write = [&plain](std::vector<char> const& data, std::size_t size){
+        std::ofstream(plain, std::ios::binary | std::ios::trunc).write(data.data(), std::streamsize(size));
+    };
+
+    auto flipped = bytes;
+    flipped[flipped.size() / 2] ^= 0x10;
+    write(flipped, flipped.size());
+
+    Forest damaged;
+    EXPECT_FALSE(damaged.load_binary(plain));
+
+    write(bytes, bytes.size() - 100);
+
+    Forest truncated;
+    EXPECT_FALSE(truncated.load_binary(plain));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(plain);
+}
+
+#endif